@@ -0,0 +1,373 @@
+/*
+ * rcar_cluster_client.c  --  R-Car Cluster client library
+ *
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/rpmsg.h>
+
+#include "rcar_cluster_client.h"
+
+#define RCAR_CLUSTER_CLASS_DIR  "/sys/class/rpmsg"
+#define RCAR_CLUSTER_EPT_NAME   "taurus-cluster"
+
+typedef struct rcar_cluster_done_cb {
+    rcar_cluster_done_t done;
+    void               *priv;
+    int                 status;
+} rcar_cluster_done_cb_t;
+
+/*
+ * Pending values, data[] is written to the device as is, cb[] holds the
+ * completion callback of the value with the same index.
+ */
+typedef struct rcar_cluster_batch {
+    taurus_cluster_data_t  *data;
+    rcar_cluster_done_cb_t *cb;
+    size_t                  count;
+    size_t                  size;
+} rcar_cluster_batch_t;
+
+struct rcar_cluster_client {
+    int                  fd;
+    unsigned int         flush_us;
+    pthread_t            thread;
+    pthread_mutex_t      lock;          /* pending, stop */
+    pthread_cond_t       cond;
+    pthread_mutex_t      send_lock;     /* keeps batches in submit order */
+    rcar_cluster_batch_t pending;
+    int                  stop;
+};
+
+/* -----------------------------------------------------------------------------
+ * Endpoint discovery
+ */
+
+static int find_endpoint(const char *ctrl, char *path, size_t size)
+{
+    char dir[PATH_MAX];
+    struct dirent *d;
+    DIR *ctrl_dir;
+    int ret = -ENOENT;
+
+    snprintf(dir, sizeof(dir), RCAR_CLUSTER_CLASS_DIR "/%s", ctrl);
+    ctrl_dir = opendir(dir);
+    if (!ctrl_dir)
+        return -errno;
+
+    while ((d = readdir(ctrl_dir)) != NULL) {
+        if (strncmp(d->d_name, "rpmsg", 5) || d->d_name[5] < '0' || d->d_name[5] > '9')
+            continue;
+        snprintf(path, size, "/dev/%s", d->d_name);
+        ret = 0;
+        break;
+    }
+
+    closedir(ctrl_dir);
+    return ret;
+}
+
+static int create_endpoint(const char *ctrl)
+{
+    struct rpmsg_endpoint_info info;
+    char dev[PATH_MAX];
+    int fd, ret = 0;
+
+    memset(&info, 0, sizeof(info));
+    strncpy(info.name, RCAR_CLUSTER_EPT_NAME, sizeof(info.name) - 1);
+    info.src = RPMSG_ADDR_ANY;
+    info.dst = RPMSG_ADDR_ANY;
+
+    snprintf(dev, sizeof(dev), "/dev/%s", ctrl);
+    fd = open(dev, O_RDWR);
+    if (fd < 0)
+        return -errno;
+
+    if (ioctl(fd, RPMSG_CREATE_EPT_IOCTL, &info) < 0)
+        ret = -errno;
+
+    close(fd);
+    return ret;
+}
+
+int rcar_cluster_discover(char *path, size_t size)
+{
+    struct dirent *d;
+    DIR *cls;
+    int ret = -ENODEV, i;
+
+    cls = opendir(RCAR_CLUSTER_CLASS_DIR);
+    if (!cls)
+        return -errno;
+
+    while ((d = readdir(cls)) != NULL) {
+        if (strncmp(d->d_name, "rpmsg_ctrl", 10))
+            continue;
+
+        ret = find_endpoint(d->d_name, path, size);
+        if (ret == -ENOENT) {
+            ret = create_endpoint(d->d_name);
+            if (!ret)
+                ret = find_endpoint(d->d_name, path, size);
+        }
+        if (!ret)
+            break;
+    }
+    closedir(cls);
+
+    if (ret)
+        return ret;
+
+    /* the device node may still be on its way from udev */
+    for (i = 0; i < 100 && access(path, W_OK); i++)
+        usleep(10000);
+
+    return access(path, W_OK) ? -errno : 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * Batching
+ */
+
+static int batch_add(rcar_cluster_batch_t *batch, const taurus_cluster_data_t *data,
+                     rcar_cluster_done_t done, void *priv)
+{
+    if (batch->count == batch->size) {
+        size_t size = batch->size ? batch->size * 2 : 16;
+        taurus_cluster_data_t *d = realloc(batch->data, size * sizeof(*d));
+        rcar_cluster_done_cb_t *cb;
+
+        if (!d)
+            return -ENOMEM;
+        batch->data = d;
+
+        cb = realloc(batch->cb, size * sizeof(*cb));
+        if (!cb)
+            return -ENOMEM;
+        batch->cb = cb;
+        batch->size = size;
+    }
+
+    batch->data[batch->count] = *data;
+    batch->cb[batch->count].done = done;
+    batch->cb[batch->count].priv = priv;
+    batch->cb[batch->count].status = 0;
+    batch->count++;
+    return 0;
+}
+
+/*
+ * Write the batch. A short write stops at the value that failed in the
+ * driver, after its retransmissions. It gets -EIO and is skipped rather than
+ * sent again, the write continues with the value after it.
+ */
+static int batch_write(int fd, rcar_cluster_batch_t *batch)
+{
+    size_t sent = 0, i;
+    int ret = 0;
+    ssize_t n;
+
+    while (sent < batch->count) {
+        n = write(fd, &batch->data[sent], (batch->count - sent) * sizeof(*batch->data));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (!ret)
+                ret = -errno;
+            batch->cb[sent++].status = -errno;
+            continue;
+        }
+        n /= sizeof(*batch->data);
+        for (i = 0; i < (size_t)n; i++)
+            batch->cb[sent++].status = 0;
+        if (sent < batch->count) {
+            if (!ret)
+                ret = -EIO;
+            batch->cb[sent++].status = -EIO;
+        }
+    }
+
+    return ret;
+}
+
+static void batch_done(rcar_cluster_batch_t *batch)
+{
+    size_t i;
+
+    for (i = 0; i < batch->count; i++)
+        if (batch->cb[i].done)
+            batch->cb[i].done(&batch->data[i], batch->cb[i].status, batch->cb[i].priv);
+
+    free(batch->data);
+    free(batch->cb);
+}
+
+static int client_flush(rcar_cluster_client_t *client)
+{
+    rcar_cluster_batch_t batch;
+    int ret;
+
+    pthread_mutex_lock(&client->send_lock);
+
+    pthread_mutex_lock(&client->lock);
+    batch = client->pending;
+    memset(&client->pending, 0, sizeof(client->pending));
+    pthread_mutex_unlock(&client->lock);
+
+    ret = batch_write(client->fd, &batch);
+
+    pthread_mutex_unlock(&client->send_lock);
+
+    batch_done(&batch);
+    return ret;
+}
+
+/* Sleeps until values are pending, then flushes once per flush interval */
+static void *client_thread(void *arg)
+{
+    rcar_cluster_client_t *client = arg;
+    struct timespec deadline;
+
+    pthread_mutex_lock(&client->lock);
+    while (!client->stop) {
+        while (!client->stop && !client->pending.count)
+            pthread_cond_wait(&client->cond, &client->lock);
+
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += client->flush_us / 1000000;
+        deadline.tv_nsec += (long)(client->flush_us % 1000000) * 1000;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000;
+        deadline.tv_nsec %= 1000000000;
+
+        while (!client->stop &&
+               pthread_cond_timedwait(&client->cond, &client->lock, &deadline) != ETIMEDOUT)
+            ;
+
+        pthread_mutex_unlock(&client->lock);
+        client_flush(client);
+        pthread_mutex_lock(&client->lock);
+    }
+    pthread_mutex_unlock(&client->lock);
+
+    return NULL;
+}
+
+/* -----------------------------------------------------------------------------
+ * API
+ */
+
+rcar_cluster_client_t *rcar_cluster_open(const char *path, unsigned int flush_us)
+{
+    rcar_cluster_client_t *client;
+    pthread_condattr_t attr;
+    char dev[PATH_MAX];
+    int ret;
+
+    if (!path) {
+        ret = rcar_cluster_discover(dev, sizeof(dev));
+        if (ret) {
+            errno = -ret;
+            return NULL;
+        }
+        path = dev;
+    }
+
+    client = calloc(1, sizeof(*client));
+    if (!client)
+        return NULL;
+
+    client->flush_us = flush_us ? flush_us : RCAR_CLUSTER_FLUSH_US;
+    client->fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (client->fd < 0) {
+        free(client);
+        return NULL;
+    }
+
+    pthread_mutex_init(&client->lock, NULL);
+    pthread_mutex_init(&client->send_lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&client->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    ret = pthread_create(&client->thread, NULL, client_thread, client);
+    if (ret) {
+        pthread_cond_destroy(&client->cond);
+        pthread_mutex_destroy(&client->send_lock);
+        pthread_mutex_destroy(&client->lock);
+        close(client->fd);
+        free(client);
+        errno = ret;
+        return NULL;
+    }
+
+    return client;
+}
+
+int rcar_cluster_submit(rcar_cluster_client_t *client, int ioctl_cmd, int value,
+                        rcar_cluster_done_t done, void *priv)
+{
+    taurus_cluster_data_t data = { .value = value, .ioctl_cmd = ioctl_cmd };
+    rcar_cluster_done_cb_t old = { NULL, NULL, 0 };
+    taurus_cluster_data_t old_data;
+    int ret = 0;
+    size_t i;
+
+    pthread_mutex_lock(&client->lock);
+
+    for (i = 0; i < client->pending.count; i++)
+        if (client->pending.data[i].ioctl_cmd == ioctl_cmd)
+            break;
+
+    if (i < client->pending.count) {
+        /* coalesce, the newer value takes the place of the pending one */
+        old = client->pending.cb[i];
+        old_data = client->pending.data[i];
+        client->pending.data[i] = data;
+        client->pending.cb[i].done = done;
+        client->pending.cb[i].priv = priv;
+    } else {
+        ret = batch_add(&client->pending, &data, done, priv);
+        if (!ret && client->pending.count == 1)
+            pthread_cond_signal(&client->cond);
+    }
+
+    pthread_mutex_unlock(&client->lock);
+
+    if (old.done)
+        old.done(&old_data, RCAR_CLUSTER_SUPERSEDED, old.priv);
+
+    return ret;
+}
+
+int rcar_cluster_flush(rcar_cluster_client_t *client)
+{
+    return client_flush(client);
+}
+
+void rcar_cluster_close(rcar_cluster_client_t *client)
+{
+    pthread_mutex_lock(&client->lock);
+    client->stop = 1;
+    pthread_cond_signal(&client->cond);
+    pthread_mutex_unlock(&client->lock);
+
+    pthread_join(client->thread, NULL);
+    client_flush(client);
+
+    pthread_cond_destroy(&client->cond);
+    pthread_mutex_destroy(&client->send_lock);
+    pthread_mutex_destroy(&client->lock);
+    close(client->fd);
+    free(client);
+}
@@ -0,0 +1,68 @@
+#ifndef RCAR_CLUSTER_CLIENT_H
+#define RCAR_CLUSTER_CLIENT_H
+
+#include <stddef.h>
+
+#include "r_taurus_cluster_protocol.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ * Client library for the R-Car Cluster endpoint device.
+ *
+ * Values submitted with rcar_cluster_submit() are collected per signal
+ * (ioctl_cmd) and written to the endpoint by a background thread once per
+ * flush interval, all pending values in one write(). A value replaced by a
+ * newer one of the same signal before it was written is not sent, its
+ * callback gets RCAR_CLUSTER_SUPERSEDED. All functions are thread safe.
+ */
+
+/* Callback status of a value replaced before it was sent */
+#define RCAR_CLUSTER_SUPERSEDED    1
+
+/* Default flush interval */
+#define RCAR_CLUSTER_FLUSH_US      1000
+
+typedef struct rcar_cluster_client rcar_cluster_client_t;
+
+/*
+ * Completion callback, called from the flushing thread.
+ * status: 0 - sent and completed by TAURUS
+ *         RCAR_CLUSTER_SUPERSEDED - replaced by a newer value
+ *         <0 - negative errno of the failed write, -EIO for the value a
+ *              short write stopped at
+ */
+typedef void (*rcar_cluster_done_t)(const taurus_cluster_data_t *data, int status, void *priv);
+
+/*
+ * Find the endpoint device of the first cluster control device and create it
+ * with RPMSG_CREATE_EPT_IOCTL if it does not exist yet. Writes the device
+ * path (e.g. "/dev/rpmsg0") to path. Returns 0 or a negative errno.
+ */
+int rcar_cluster_discover(char *path, size_t size);
+
+/*
+ * Open the endpoint device at path, or the discovered one if path is NULL,
+ * and start the flushing thread. flush_us 0 selects RCAR_CLUSTER_FLUSH_US.
+ * Returns NULL with errno set on failure.
+ */
+rcar_cluster_client_t *rcar_cluster_open(const char *path, unsigned int flush_us);
+
+/* Queue a value, done (may be NULL) is called once it was handled */
+int rcar_cluster_submit(rcar_cluster_client_t *client, int ioctl_cmd, int value,
+                        rcar_cluster_done_t done, void *priv);
+
+/* Write all pending values now, returns after their callbacks ran */
+int rcar_cluster_flush(rcar_cluster_client_t *client);
+
+/* Flush pending values, stop the thread and close the device */
+void rcar_cluster_close(rcar_cluster_client_t *client);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RCAR_CLUSTER_CLIENT_H */
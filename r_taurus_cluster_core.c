@@ -0,0 +1,122 @@
+/*
+ * r_taurus_cluster_core.c  --  R-Car Cluster protocol core
+ *
+ */
+
+#include "r_taurus_cluster_core.h"
+
+void r_taurus_cluster_encode(R_TAURUS_CmdMsg_t *msg, const taurus_cluster_data_t *data)
+{
+	msg->Per = TAURUS_PROTOCOL_CLUSTER_ID;
+	msg->Channel = R_TAURUS_CLUSTER_CHANNEL;
+	msg->Cmd = R_TAURUS_CMD_IOCTL;
+	msg->Par1 = data->ioctl_cmd;
+	// if gear , replace the negative value with positive
+	msg->Par2 = data->ioctl_cmd == RCAR_IO_GEAR && data->value < 0 /*it is reverse gear position */? RCAR_IO_GEAR_REVERSE : data->value;
+	msg->Par3 = 0;
+}
+
+void r_taurus_cluster_encode_bulk(R_TAURUS_CmdMsg_t *msg, int kind,
+				  uint64_t offset, uint64_t len)
+{
+	msg->Per = TAURUS_PROTOCOL_CLUSTER_ID;
+	msg->Channel = RCAR_CLUSTER_BULK_CHANNEL(kind);
+	msg->Cmd = R_TAURUS_CMD_WRITE;
+	msg->Par1 = offset;
+	msg->Par2 = len;
+	msg->Par3 = 0;
+}
+
+unsigned int r_taurus_cluster_msg_class(const R_TAURUS_CmdMsg_t *msg)
+{
+	if (msg->Cmd == R_TAURUS_CMD_WRITE)
+		return msg->Channel - RCAR_CLUSTER_BULK_CHANNEL(0);
+
+	return msg->Par1;
+}
+
+bool r_taurus_cluster_unsolicited(const R_TAURUS_ResultMsg_t *res)
+{
+	return res->Result == R_TAURUS_CMD_NOP && res->Id == 0;
+}
+
+bool r_taurus_cluster_rejected(const R_TAURUS_ResultMsg_t *res)
+{
+	return res->Result == R_TAURUS_RES_NACK || res->Result == R_TAURUS_RES_ERROR;
+}
+
+void r_taurus_txn_init(r_taurus_txn_t *txn, uint32_t id)
+{
+	txn->Id = id;
+	txn->AckReceived = false;
+	txn->AckNs = 0;
+	txn->AckAux = 0;
+	txn->DoneNs = 0;
+	txn->Rejected = false;
+	txn->Next = NULL;
+	txn->Pprev = NULL;
+}
+
+int r_taurus_txn_update(r_taurus_txn_t *txn, const R_TAURUS_ResultMsg_t *res,
+			uint64_t now_ns)
+{
+	if (res->Id != txn->Id)
+		return R_TAURUS_TXN_NONE;
+
+	if (r_taurus_cluster_rejected(res)) {
+		/* no COMPLETE will follow, an earlier ACK keeps its time */
+		if (!txn->AckReceived)
+			txn->AckNs = now_ns;
+		txn->DoneNs = now_ns;
+		txn->AckReceived = true;
+		txn->Rejected = true;
+		return R_TAURUS_TXN_REJECTED;
+	}
+
+	if (txn->AckReceived) {
+		txn->DoneNs = now_ns;
+		return R_TAURUS_TXN_COMPLETE;
+	}
+
+	txn->AckNs = now_ns;
+	txn->AckAux = res->Aux;
+	txn->AckReceived = true;
+	return R_TAURUS_TXN_ACK;
+}
+
+unsigned int r_taurus_txn_bucket(uint32_t id, unsigned int nbuckets)
+{
+	return (id / R_TAURUS_TXN_ID_BATCH) % nbuckets;
+}
+
+void r_taurus_txn_link(r_taurus_txn_list_t *list, r_taurus_txn_t *txn)
+{
+	txn->Next = list->Head;
+	if (txn->Next)
+		txn->Next->Pprev = &txn->Next;
+	txn->Pprev = &list->Head;
+	list->Head = txn;
+}
+
+void r_taurus_txn_unlink(r_taurus_txn_t *txn)
+{
+	*txn->Pprev = txn->Next;
+	if (txn->Next)
+		txn->Next->Pprev = txn->Pprev;
+	txn->Next = NULL;
+	txn->Pprev = NULL;
+}
+
+int r_taurus_txn_match(r_taurus_txn_list_t *list, const R_TAURUS_ResultMsg_t *res,
+		       uint64_t now_ns, r_taurus_txn_t **match)
+{
+	r_taurus_txn_t *txn;
+
+	for (txn = list->Head; txn; txn = txn->Next)
+		if (txn->Id == res->Id) {
+			*match = txn;
+			return r_taurus_txn_update(txn, res, now_ns);
+		}
+
+	return R_TAURUS_TXN_NONE;
+}
@@ -0,0 +1,132 @@
+#ifndef R_TAURUS_CLUSTER_CORE_H
+#define R_TAURUS_CLUSTER_CORE_H
+
+/*
+ * Kernel independent part of the cluster protocol: encoding of commands and
+ * the ACK/COMPLETE state machine of a transaction. It is linked into the
+ * driver and, for profiling on a workstation, into a userspace library
+ * (make core, make core-bench). Nothing in here may use kernel APIs.
+ */
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include <linux/stddef.h>
+#else
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+#include "r_taurus_cluster_protocol.h"
+#include "r_taurus_protocol_ids.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define R_TAURUS_CLUSTER_CHANNEL   0x80
+
+/* taurus_cluster_data_t::ioctl_cmd */
+#define RCAR_IO_SPEED              1
+#define RCAR_IO_GEAR               2
+
+#define RCAR_IO_GEAR_REVERSE       4        /* wire value of a negative gear */
+
+/* Result of r_taurus_txn_update() */
+#define R_TAURUS_TXN_NONE          0        /* result not for this transaction */
+#define R_TAURUS_TXN_ACK           1        /* TAURUS accepted the command */
+#define R_TAURUS_TXN_COMPLETE      2        /* TAURUS finished the command */
+#define R_TAURUS_TXN_REJECTED      3        /* NACK/ERROR, no COMPLETE follows */
+
+/* Transaction Ids are handed out to a sender in batches of this many */
+#define R_TAURUS_TXN_ID_BATCH      64
+
+/*******************************************************************************
+  Type: r_taurus_txn_t
+
+  State of one outstanding command.
+
+  Members:
+  Id            - Transaction Id of the command
+  AckReceived   - First result (ACK) arrived
+  AckNs         - ACK arrival time
+  AckAux        - Aux of the ACK
+  DoneNs        - COMPLETE (or NACK/ERROR) arrival time
+  Rejected      - Ended with NACK/ERROR instead of COMPLETE
+  Next, Pprev   - Links of the outstanding transaction list
+*/
+
+typedef struct r_taurus_txn {
+    uint32_t              Id;
+    bool                  AckReceived;
+    uint64_t              AckNs;
+    uint64_t              AckAux;
+    uint64_t              DoneNs;
+    bool                  Rejected;
+    struct r_taurus_txn  *Next;
+    struct r_taurus_txn **Pprev;
+} r_taurus_txn_t;
+
+/*******************************************************************************
+  Type: r_taurus_txn_list_t
+
+  Outstanding transactions of one hash bucket, see r_taurus_txn_bucket().
+  The caller serializes all operations on a list.
+
+  Members:
+  Head          - First transaction, NULL if empty
+*/
+
+typedef struct r_taurus_txn_list {
+    r_taurus_txn_t *Head;
+} r_taurus_txn_list_t;
+
+/* Build the IOCTL command of a cluster value, Id and Par3 are left to the sender */
+void r_taurus_cluster_encode(R_TAURUS_CmdMsg_t *msg, const taurus_cluster_data_t *data);
+
+/* Build the WRITE command of a bulk payload at offset in the shared region */
+void r_taurus_cluster_encode_bulk(R_TAURUS_CmdMsg_t *msg, int kind,
+                                  uint64_t offset, uint64_t len);
+
+/*
+ * Signal class of an IOCTL command, index of the per class settings and
+ * statistics, or the payload kind of a bulk WRITE command
+ */
+unsigned int r_taurus_cluster_msg_class(const R_TAURUS_CmdMsg_t *msg);
+
+/* Unsolicited NOP result which belongs to no transaction */
+bool r_taurus_cluster_unsolicited(const R_TAURUS_ResultMsg_t *res);
+
+/* NACK or ERROR result */
+bool r_taurus_cluster_rejected(const R_TAURUS_ResultMsg_t *res);
+
+void r_taurus_txn_init(r_taurus_txn_t *txn, uint32_t id);
+
+/* Feed a result received at now_ns, returns R_TAURUS_TXN_xxx */
+int r_taurus_txn_update(r_taurus_txn_t *txn, const R_TAURUS_ResultMsg_t *res,
+                        uint64_t now_ns);
+
+/*
+ * Bucket of the transaction Id among nbuckets lists. All Ids of one batch
+ * share a bucket, so senders on different cpus mostly use different ones.
+ */
+unsigned int r_taurus_txn_bucket(uint32_t id, unsigned int nbuckets);
+
+void r_taurus_txn_link(r_taurus_txn_list_t *list, r_taurus_txn_t *txn);
+
+void r_taurus_txn_unlink(r_taurus_txn_t *txn);
+
+/*
+ * Find the transaction of a result in list and feed it the result, see
+ * r_taurus_txn_update(). Returns R_TAURUS_TXN_xxx and the transaction in
+ * *match, R_TAURUS_TXN_NONE if no transaction in list has the result's Id.
+ */
+int r_taurus_txn_match(r_taurus_txn_list_t *list, const R_TAURUS_ResultMsg_t *res,
+                       uint64_t now_ns, r_taurus_txn_t **match);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* R_TAURUS_CLUSTER_CORE_H */
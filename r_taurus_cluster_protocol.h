@@ -5,13 +5,87 @@
 # define __packed       __attribute__((__packed__))
 #endif
 
+#include <linux/ioctl.h>
 #include "r_taurus_bridge.h"
 
+#define RCAR_CLUSTER_IOC_MAGIC          0xc3
+
+/*
+ * Endpoint device ioctls, in addition to RPMSG_DESTROY_EPT_IOCTL. They use
+ * a magic of their own, rpmsg's 0xb5 is left to the rpmsg core.
+ *
+ * RCAR_CLUSTER_SET_BUSY_POLL_IOCTL: maximum time in microseconds a writer
+ * spins for the TAURUS ACK/COMPLETE before it goes to sleep, 0 disables busy
+ * polling. The spin budgets of ACK and of COMPLETE waits adapt separately to
+ * the observed response times below this bound. Statistics are in
+ * /sys/class/rpmsg/rpmsgN/busy_poll_*.
+ */
+#define RCAR_CLUSTER_SET_BUSY_POLL_IOCTL _IOW(RCAR_CLUSTER_IOC_MAGIC, 0x01, unsigned int)
+
+/*
+ * RCAR_CLUSTER_BULK_WRITE_IOCTL: pass a large payload (telltale bitmap,
+ * warning text, trip data, ...) through the reserved memory region shared
+ * with TAURUS instead of inline rpmsg messages. The payload is placed in a
+ * DMA coherent buffer of that region and sent as R_TAURUS_CMD_WRITE on
+ * channel RCAR_CLUSTER_BULK_CHANNEL(ioctl_cmd), with
+ *   Par1 - offset of the buffer from the start of the region
+ *   Par2 - length of the payload
+ * The ioctl returns when TAURUS has completed the command. It fails with
+ * ENODEV if the device tree provides no memory-region named "cluster-bulk".
+ */
+typedef struct taurus_cluster_bulk {
+    int                ioctl_cmd;       /* payload kind */
+    unsigned int       len;             /* payload length in bytes */
+    unsigned long long buf;             /* userspace address of the payload */
+}taurus_cluster_bulk_t;
+
+#define RCAR_CLUSTER_BULK_CHANNEL(kind) (0x100 + (kind))
+#define RCAR_CLUSTER_BULK_WRITE_IOCTL   _IOW(RCAR_CLUSTER_IOC_MAGIC, 0x02, taurus_cluster_bulk_t)
+
+/*
+ * write() on the endpoint device takes one or more taurus_cluster_data_t.
+ * The values are sent in order, a short write reports how many were sent
+ * before the first failure. The value after them failed after its
+ * retransmissions, writing it again starts a new attempt.
+ */
 typedef struct taurus_cluster_data {
     int   value;
     int   ioctl_cmd;
 }taurus_cluster_data_t;
 
+/*
+ * Every command carries its CLOCK_MONOTONIC submit time in ns in Par3.
+ * TAURUS may echo it in Aux of the ACK. All times are taken on the guest
+ * clock, the per signal round trip breakdown is in
+ * /sys/class/rpmsg/rpmsg_ctrlN/latency.
+ */
+
+/*
+ * RCAR_CLUSTER_SCHEDULE_IOCTL: queue values to be sent at a future
+ * CLOCK_MONOTONIC instant (due_ns). Entries falling due together are
+ * dequeued together and sent in due order; of several entries with the same
+ * ioctl_cmd among them only the last one is sent. Batching saves wakeups
+ * only, every value is still its own command and round trip to TAURUS. A
+ * value TAURUS rejects or does not answer within the timed_timeout_ms module
+ * parameter is not retransmitted, it is counted in
+ * /sys/class/rpmsg/rpmsgN/timed_dropped. Queued entries are dropped on
+ * close() or with RCAR_CLUSTER_FLUSH_SCHEDULE_IOCTL.
+ */
+typedef struct taurus_cluster_timed {
+    unsigned long long    due_ns;
+    taurus_cluster_data_t data;
+}taurus_cluster_timed_t;
+
+typedef struct taurus_cluster_schedule {
+    unsigned int       count;           /* number of entries */
+    unsigned int       reserved;
+    unsigned long long entries;         /* userspace address of taurus_cluster_timed_t[count] */
+}taurus_cluster_schedule_t;
+
+#define RCAR_CLUSTER_SCHEDULE_MAX           256    /* entries per ioctl */
+#define RCAR_CLUSTER_SCHEDULE_IOCTL         _IOW(RCAR_CLUSTER_IOC_MAGIC, 0x03, taurus_cluster_schedule_t)
+#define RCAR_CLUSTER_FLUSH_SCHEDULE_IOCTL   _IO(RCAR_CLUSTER_IOC_MAGIC, 0x04)
+
 typedef struct taurus_cluster_res_msg {
     R_TAURUS_ResultMsg_t hdr;
 }taurus_cluster_res_msg_t;
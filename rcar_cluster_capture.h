@@ -0,0 +1,30 @@
+#ifndef RCAR_CLUSTER_CAPTURE_H
+#define RCAR_CLUSTER_CAPTURE_H
+
+#include "r_taurus_bridge.h"
+
+/*
+ * Record format of the traffic capture ring.
+ *
+ * When the driver is loaded with capture_subbufs > 0 every command sent to
+ * TAURUS and every result received from it is appended to a per-cpu relay
+ * buffer, exported as debugfs files
+ *   /sys/kernel/debug/rcar_cluster/<rpmsg_ctrlN>/capture<cpu>
+ * Each file is a plain stream of fixed size records. Records of different
+ * cpus have to be merged by ts_ns (see tools/cluster_replay.c).
+ */
+
+#define RCAR_CLUSTER_CAPTURE_TX    1       /* R_TAURUS_CmdMsg_t sent to TAURUS */
+#define RCAR_CLUSTER_CAPTURE_RX    2       /* R_TAURUS_ResultMsg_t received */
+
+typedef struct rcar_cluster_capture_rec {
+    uint64_t ts_ns;                     /* CLOCK_MONOTONIC, nanoseconds */
+    uint32_t dir;                       /* RCAR_CLUSTER_CAPTURE_TX/RX */
+    uint32_t len;                       /* valid bytes in msg */
+    union {
+        R_TAURUS_CmdMsg_t    cmd;
+        R_TAURUS_ResultMsg_t res;
+    } msg;
+} rcar_cluster_capture_rec_t;
+
+#endif /* RCAR_CLUSTER_CAPTURE_H */
@@ -3,37 +3,140 @@
 
 #include <linux/kernel.h>
 #include <linux/list.h>
+#include <linux/cache.h>
+#include <linux/percpu.h>
+#include <linux/hrtimer.h>
+#include <linux/workqueue.h>
+#include <linux/u64_stats_sync.h>
+
+#include "r_taurus_cluster_core.h"
 
 struct taurus_rvgc_res_msg;
 
+/* Outstanding command, lives on the sender's stack while it is hashed */
 typedef struct taurus_event_list {
-        uint32_t id;
-        struct taurus_cluster_res_msg* result;
-        struct list_head list;
+        r_taurus_txn_t txn;             /* Id, ACK/COMPLETE state and bucket links, CLOCK_MONOTONIC times */
+        struct taurus_cluster_res_msg result;
         struct completion ack;
-        bool ack_received;
         struct completion completed;
 }taurus_event_list_t;
 
+/* Adaptive spin state of one kind of wait, ACKs arrive much sooner than COMPLETEs */
+typedef struct rcar_cluster_busy_poll_wait {
+        unsigned int budget_ns;         /* current adaptive spin budget */
+        unsigned int avg_ns;            /* running average response time */
+} rcar_cluster_busy_poll_wait_t;
+
+#define RCAR_CLUSTER_WAIT_ACK           0
+#define RCAR_CLUSTER_WAIT_COMPLETE      1
+
+/* Adaptive busy polling of ACK/COMPLETE, one per endpoint */
+typedef struct rcar_cluster_busy_poll {
+        unsigned int max_ns;            /* upper spin bound, 0: disabled */
+        rcar_cluster_busy_poll_wait_t wait[2]; /* by RCAR_CLUSTER_WAIT_xxx */
+        atomic_long_t hits;             /* response arrived while spinning */
+        atomic_long_t misses;           /* fell back to sleeping */
+} rcar_cluster_busy_poll_t;
+
+/* Value queued for transmission at due_ns, see RCAR_CLUSTER_SCHEDULE_IOCTL */
+typedef struct rcar_cluster_timed_entry {
+        struct list_head list;
+        u64 due_ns;
+        bool superseded;
+        taurus_cluster_data_t data;
+} rcar_cluster_timed_entry_t;
+
+/* Signal classes (taurus_cluster_data_t::ioctl_cmd) with own retry settings */
+#define RCAR_CLUSTER_SIGNAL_CLASSES     16
+
+/* Bulk payload kinds (taurus_cluster_bulk_t::ioctl_cmd) with own statistics */
+#define RCAR_CLUSTER_BULK_KINDS         16
+
+/*
+ * Round trip breakdown per signal class or bulk kind on the guest clock,
+ * sums in ns over count completed commands:
+ *   queue      - send_cmd() entry until rpmsg_send() returned
+ *   transport  - submit stamp (Par3) until the ACK arrived
+ *   processing - ACK until COMPLETE arrived, TAURUS processing including
+ *                the return trip of the COMPLETE
+ * Commands ended by NACK/ERROR, retransmitted or not, are only counted in
+ * rejected.
+ */
+typedef struct rcar_cluster_latency {
+        u64 count;
+        u64 queue_ns;
+        u64 transport_ns;
+        u64 processing_ns;
+        u64 rejected;
+} rcar_cluster_latency_t;
+
+/* Per-cpu statistics of the writers on that cpu, summed up by latency_show() */
+typedef struct rcar_cluster_stats {
+        struct u64_stats_sync syncp;
+        rcar_cluster_latency_t latency[RCAR_CLUSTER_SIGNAL_CLASSES];
+        rcar_cluster_latency_t bulk[RCAR_CLUSTER_BULK_KINDS];
+        u64 echo_count;                 /* ACKs echoing the Par3 stamp in Aux */
+} rcar_cluster_stats_t;
+
+/*
+ * Outstanding commands are hashed by transaction Id batch (see
+ * r_taurus_txn_bucket() and cluster_taurus_get_uniq_id()), so writers on
+ * different cpus and the rx callback mostly take different bucket locks.
+ */
+#define RCAR_CLUSTER_EVENT_BUCKETS      16
+
+typedef struct rcar_cluster_event_bucket {
+        spinlock_t lock;
+        r_taurus_txn_list_t txns;       /* taurus_event_list::txn */
+} ____cacheline_aligned_in_smp rcar_cluster_event_bucket_t;
+
+/* Per-cpu batch of transaction Ids, refilled from txid_counter */
+typedef struct rcar_cluster_txid {
+        uint32_t next;
+        uint32_t end;
+} rcar_cluster_txid_t;
+
+/*
+ * The device is split in parts, each starting on its own cacheline:
+ * read-mostly setup state, the transaction Id state of the submitting
+ * writers and the hashed outstanding command lists shared by a writer and
+ * the rpmsg rx callback. This keeps concurrent writers and the rx cpu from
+ * bouncing one common cacheline.
+ */
 typedef struct rcar_cluster_device {
+        /* read-mostly */
         struct device dev;
         struct cdev cdev;
         struct rpmsg_device* rpdev;
 
         struct rpmsg_channel_info chinfo;
 
-	    struct mutex ept_lock;
-	    struct rpmsg_endpoint *ept;
+        /* traffic capture, see rcar_cluster_capture.h */
+        struct dentry *debugfs_dir;
+        struct rchan __rcu *capture;
 
-        struct list_head taurus_event_list_head;
-        rwlock_t event_list_lock;
+        /* memory-region shared with TAURUS for bulk writes, NULL if none */
+        struct reserved_mem *rmem;
+        dma_addr_t rmem_dma;            /* rmem->base in DMA address space */
 
+        rcar_cluster_stats_t __percpu *stats;
 
-        /* ?? */
-        spinlock_t queue_lock;
-	    struct sk_buff_head queue;
-	    wait_queue_head_t readq;
+        /* tx */
+        struct mutex ept_lock ____cacheline_aligned_in_smp;
+        struct rpmsg_endpoint *ept;
+        rcar_cluster_txid_t __percpu *txid;
+        atomic_t txid_counter;
+
+        /* values submitted per class, shared by all writers of a class */
+        atomic_t signal_seq[RCAR_CLUSTER_SIGNAL_CLASSES] ____cacheline_aligned_in_smp;
 
+        /* outstanding commands, one cacheline per bucket */
+        rcar_cluster_event_bucket_t events[RCAR_CLUSTER_EVENT_BUCKETS];
+
+        /* ?? */
+        spinlock_t queue_lock ____cacheline_aligned_in_smp;
+        struct sk_buff_head queue;
+        wait_queue_head_t readq;
 } rcar_cluster_device_t;
 
 #endif /* __RCAR_CLUSTER_DRV_H__ */
\ No newline at end of file
@@ -0,0 +1,1523 @@
+/*
+ * rcar_cluster_main.c  --  R-Car Cluster driver
+ *
+ * Kernel side of the driver, the protocol encoding and transaction matching
+ * live in r_taurus_cluster_core.c.
+ */
+
+//#define DEBUG
+
+#include <linux/device.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/wait.h>
+#include <linux/kthread.h>
+#include <linux/delay.h>
+#include <linux/dma-mapping.h>
+#include <linux/dma-direct.h>
+
+#include <linux/rpmsg.h>
+#include <linux/of.h>
+#include <linux/of_reserved_mem.h>
+#include <linux/atomic.h>
+#include <linux/skbuff.h>
+#include <linux/relay.h>
+#include <linux/rcupdate.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <uapi/linux/rpmsg.h>
+#include "linux/cdev.h"
+#include "r_taurus_cluster_protocol.h"
+#include "r_taurus_cluster_core.h"
+#include "rcar_cluster_capture.h"
+#include "rcar_cluster_drv.h"
+
+#pragma GCC optimize ("-Og")
+
+static DEFINE_IDA(rpmsg_ctrl_ida);
+static DEFINE_IDA(rpmsg_ept_ida);
+static DEFINE_IDA(rpmsg_minor_ida);
+
+#define RPMSG_DEV_MAX	(MINORMASK + 1)
+
+#define RCAR_CLUSTER_DRM_NAME     "rcar-cluster-drv"
+#define RCAR_CLUSTER_BULK_REGION  "cluster-bulk"
+
+static unsigned int capture_subbufs;
+module_param(capture_subbufs, uint, 0444);
+MODULE_PARM_DESC(capture_subbufs, "Number of per-cpu capture sub-buffers, 0 disables traffic capture");
+
+static unsigned int capture_subbuf_size = 64 * 1024;
+module_param(capture_subbuf_size, uint, 0444);
+MODULE_PARM_DESC(capture_subbuf_size, "Size in bytes of one capture sub-buffer");
+
+static struct dentry *cluster_debugfs_root;
+
+static unsigned int busy_poll_us;
+module_param(busy_poll_us, uint, 0644);
+MODULE_PARM_DESC(busy_poll_us, "Default busy poll bound in us for new endpoints, 0 disables busy polling");
+
+#define BUSY_POLL_MIN_NS	500
+
+static unsigned int timed_queue_max = 1024;
+module_param(timed_queue_max, uint, 0644);
+MODULE_PARM_DESC(timed_queue_max, "Maximum number of scheduled values per endpoint");
+
+static unsigned int timed_batch_us = 100;
+module_param(timed_batch_us, uint, 0644);
+MODULE_PARM_DESC(timed_batch_us, "Scheduled values due within this many us are dequeued together");
+
+static unsigned int timed_timeout_ms = 20;
+module_param(timed_timeout_ms, uint, 0644);
+MODULE_PARM_DESC(timed_timeout_ms, "Time a scheduled value waits for the TAURUS ACK and for the COMPLETE");
+
+static unsigned int retry_budget[RCAR_CLUSTER_SIGNAL_CLASSES] = {
+	[0 ... RCAR_CLUSTER_SIGNAL_CLASSES - 1] = 3
+};
+module_param_array(retry_budget, uint, NULL, 0644);
+MODULE_PARM_DESC(retry_budget, "Retransmissions after NACK/ERROR per signal class, 0 disables");
+
+static unsigned int retry_backoff_us[RCAR_CLUSTER_SIGNAL_CLASSES] = {
+	[0 ... RCAR_CLUSTER_SIGNAL_CLASSES - 1] = 50
+};
+module_param_array(retry_backoff_us, uint, NULL, 0644);
+MODULE_PARM_DESC(retry_backoff_us, "Initial retransmission backoff in us per signal class, doubled on every retry");
+
+static unsigned int retry_backoff_max_us = 10000;
+module_param(retry_backoff_max_us, uint, 0644);
+MODULE_PARM_DESC(retry_backoff_max_us, "Upper bound of the retransmission backoff in us");
+
+
+/**
+ * struct rpmsg_ctrldev - control device for instantiating endpoint devices
+ * @rpdev:	underlaying rpmsg device
+ * @cdev:	cdev for the ctrl device
+ * @dev:	device for the ctrl device
+ */
+struct rpmsg_ctrldev {
+	struct rpmsg_device *rpdev;
+	struct cdev cdev;
+	struct device dev;
+};
+
+/**
+ * struct rpmsg_eptdev - endpoint device context
+ * @dev:	endpoint device
+ * @cdev:	cdev for the endpoint device
+ * @rpdev:	underlaying rpmsg device
+ * @chinfo:	info used to open the endpoint
+ * @ept_lock:	synchronization of @ept modifications
+ * @ept:	rpmsg endpoint reference, when open
+ * @queue_lock:	synchronization of @queue operations
+ * @queue:	incoming message queue
+ * @readq:	wait object for incoming queue
+ * @poll:	busy poll settings and statistics of ACK/COMPLETE waits
+ * @timed_mutex: serializes schedule and flush of the timed queue
+ * @timed_lock:	synchronization of @timed_list
+ * @timed_list:	values scheduled for transmission, sorted by due time
+ * @timed_count: number of entries in @timed_list
+ * @timed_timer: fires at the due time of the first entry
+ * @timed_wq:	ordered workqueue running @timed_work
+ * @timed_work:	sends the entries that are due
+ * @timed_abort: set by cluster_timed_flush() to drop the entries in flight
+ * @timed_dropped: due entries not delivered, send failed or flush dropped them
+ */
+typedef struct rcar_cluster_eptdev {
+	struct device dev;
+	struct cdev cdev;
+
+	struct rpmsg_device *rpdev;
+	struct rpmsg_channel_info chinfo;
+
+	struct mutex ept_lock;
+	struct rpmsg_endpoint *ept;
+
+	spinlock_t queue_lock;
+	struct sk_buff_head queue;
+	wait_queue_head_t readq;
+
+	rcar_cluster_busy_poll_t poll;
+
+	struct mutex timed_mutex;
+	spinlock_t timed_lock;
+	struct list_head timed_list;
+	unsigned int timed_count;
+	struct hrtimer timed_timer;
+	struct workqueue_struct *timed_wq;
+	struct work_struct timed_work;
+	bool timed_abort;
+	atomic_long_t timed_dropped;
+} rcar_cluster_eptdev_t;
+
+static dev_t rpmsg_major;
+static struct class *rpmsg_class;
+
+#define dev_to_rcar_eptdev(dev) container_of(dev, rcar_cluster_eptdev_t, dev)
+#define cdev_to_rcar_eptdev(i_cdev) container_of(i_cdev, rcar_cluster_eptdev_t, cdev)
+
+#define dev_to_clusterdev(dev) container_of(dev, rcar_cluster_device_t, dev)
+#define cdev_to_clusterdev(i_cdev) container_of(i_cdev, rcar_cluster_device_t, cdev)
+
+static int rpmsg_cluster_probe(struct rpmsg_device *rpdev);
+static int rpmsg_cluster_cb(struct rpmsg_device* rpdev, void* data, int len,
+			void* priv, u32 src);
+static void rpmsg_cluster_remove(struct rpmsg_device *rpdev);
+static int rpmsg_eptdev_open(struct inode *inode, struct file *filp);
+static int rpmsg_eptdev_release(struct inode *inode, struct file *filp);
+static ssize_t rpmsg_eptdev_write_iter(struct kiocb *iocb,
+				       struct iov_iter *from);
+static long rpmsg_eptdev_ioctl(struct file *fp, unsigned int cmd,
+			       unsigned long arg);
+
+static int rpmsg_ctrldev_open(struct inode *inode, struct file *filp);
+static int rpmsg_ctrldev_release(struct inode *inode, struct file *filp);
+static long rpmsg_ctrldev_ioctl(struct file *fp, unsigned int cmd,
+				unsigned long arg);	   
+
+static struct rpmsg_device_id rpmsg_driver_cluster_id_table[] = {
+	{ .name	= "taurus-cluster" },
+	{ },
+};
+
+static struct rpmsg_driver rpmsg_cluster_drv = {
+	.drv.name	= "rpmsg_chrdev",/*KBUILD_MODNAME,*/
+	.drv.probe_type = PROBE_PREFER_ASYNCHRONOUS,
+	.id_table	= rpmsg_driver_cluster_id_table,
+	.probe		= rpmsg_cluster_probe,
+	.callback	= rpmsg_cluster_cb,
+	.remove		= rpmsg_cluster_remove,
+};
+
+
+static const struct file_operations rpmsg_eptdev_fops = {
+	.owner = THIS_MODULE,
+	.open = rpmsg_eptdev_open,
+	.release = rpmsg_eptdev_release,
+	/*.read_iter = rpmsg_eptdev_read_iter,*/
+	.write_iter = rpmsg_eptdev_write_iter,
+	/*.poll = rpmsg_eptdev_poll,*/
+	.unlocked_ioctl = rpmsg_eptdev_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
+};
+
+static const struct file_operations rpmsg_ctrldev_fops = {
+	.owner = THIS_MODULE,
+	.open = rpmsg_ctrldev_open,
+	.release = rpmsg_ctrldev_release,
+	.unlocked_ioctl = rpmsg_ctrldev_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
+};
+
+/*
+ * Transaction Ids are handed out from per-cpu batches, so concurrent writers
+ * only touch the shared counter once every R_TAURUS_TXN_ID_BATCH messages.
+ * Id 0 is skipped, TAURUS uses it for unsolicited NOP results.
+ */
+static uint32_t cluster_taurus_get_uniq_id(rcar_cluster_device_t *clusterdvc) {
+	rcar_cluster_txid_t *txid;
+	uint32_t id;
+
+	do {
+		txid = get_cpu_ptr(clusterdvc->txid);
+		if (txid->next == txid->end) {
+			txid->end = atomic_add_return(R_TAURUS_TXN_ID_BATCH,
+						      &clusterdvc->txid_counter);
+			txid->next = txid->end - R_TAURUS_TXN_ID_BATCH;
+		}
+		id = txid->next++;
+		put_cpu_ptr(clusterdvc->txid);
+	} while (!id);
+
+	return id;
+}
+
+/* -----------------------------------------------------------------------------
+ * Traffic capture
+ */
+
+static struct dentry *cluster_capture_create_buf_file(const char *filename,
+			struct dentry *parent, umode_t mode,
+			struct rchan_buf *buf, int *is_global)
+{
+	return debugfs_create_file(filename, mode, parent, buf,
+				   &relay_file_operations);
+}
+
+static int cluster_capture_remove_buf_file(struct dentry *dentry)
+{
+	debugfs_remove(dentry);
+	return 0;
+}
+
+static struct rchan_callbacks cluster_capture_cb = {
+	.create_buf_file = cluster_capture_create_buf_file,
+	.remove_buf_file = cluster_capture_remove_buf_file,
+};
+
+static void cluster_capture_init(rcar_cluster_device_t *clusterdvc)
+{
+	struct rchan *chan;
+
+	if (!capture_subbufs)
+		return;
+
+	clusterdvc->debugfs_dir = debugfs_create_dir(dev_name(&clusterdvc->dev),
+						     cluster_debugfs_root);
+	chan = relay_open("capture", clusterdvc->debugfs_dir,
+			  capture_subbuf_size, capture_subbufs,
+			  &cluster_capture_cb, NULL);
+	if (!chan) {
+		dev_warn(&clusterdvc->dev, "failed to open capture channel, capture disabled\n");
+		debugfs_remove_recursive(clusterdvc->debugfs_dir);
+		clusterdvc->debugfs_dir = NULL;
+		return;
+	}
+	rcu_assign_pointer(clusterdvc->capture, chan);
+}
+
+/*
+ * The rpmsg core destroys the driver endpoint only after ->remove(), so the
+ * rx callback may still be capturing: unpublish the channel and wait for
+ * all writers to leave their RCU read side before closing it.
+ */
+static void cluster_capture_exit(rcar_cluster_device_t *clusterdvc)
+{
+	struct rchan *chan = rcu_dereference_protected(clusterdvc->capture, true);
+
+	if (chan) {
+		RCU_INIT_POINTER(clusterdvc->capture, NULL);
+		synchronize_rcu();
+		relay_close(chan);
+	}
+	debugfs_remove_recursive(clusterdvc->debugfs_dir);
+	clusterdvc->debugfs_dir = NULL;
+}
+
+/* Called from send and rpmsg callback context, relay_write() is irq safe */
+static void cluster_capture(rcar_cluster_device_t *clusterdvc, uint32_t dir,
+			    const void *msg, size_t len)
+{
+	rcar_cluster_capture_rec_t rec;
+	struct rchan *chan;
+
+	if (!rcu_access_pointer(clusterdvc->capture))
+		return;
+
+	if (len > sizeof(rec.msg))
+		len = sizeof(rec.msg);
+
+	rec.ts_ns = ktime_get_ns();
+	rec.dir = dir;
+	rec.len = len;
+	memcpy(&rec.msg, msg, len);
+	memset((u8 *)&rec.msg + len, 0, sizeof(rec.msg) - len);
+
+	rcu_read_lock();
+	chan = rcu_dereference(clusterdvc->capture);
+	if (chan)
+		relay_write(chan, &rec, sizeof(rec));
+	rcu_read_unlock();
+}
+
+/* -----------------------------------------------------------------------------
+ * Bulk data channel
+ */
+
+/*
+ * The rpmsg device has no device tree node of its own. The bulk region is
+ * the memory-region entry named RCAR_CLUSTER_BULK_REGION in
+ * memory-region-names of the closest ancestor that names one, e.g. of the
+ * remoteproc node next to its firmware and vrings:
+ *   memory-region = <&taurus_fw>, <&cluster_bulk>;
+ *   memory-region-names = "firmware", "cluster-bulk";
+ * It must be a no-map region, a reusable (CMA) one may be handed out to
+ * Linux allocations behind TAURUS' back. The region is assigned to the rpmsg
+ * device as its coherent DMA pool, so dma_alloc_coherent() hands out buffers
+ * TAURUS can address by offset.
+ */
+static void cluster_bulk_init(rcar_cluster_device_t *clusterdvc)
+{
+	struct device *dev = &clusterdvc->rpdev->dev;
+	struct device_node *np = NULL, *rmem_np;
+	struct reserved_mem *rmem = NULL;
+	struct device *parent;
+	int idx = -ENODEV, ret;
+
+	for (parent = dev; parent && !np; parent = parent->parent) {
+		if (!parent->of_node)
+			continue;
+		idx = of_property_match_string(parent->of_node, "memory-region-names",
+					       RCAR_CLUSTER_BULK_REGION);
+		if (idx >= 0)
+			np = parent->of_node;
+	}
+
+	if (!np)
+		return;
+
+	rmem_np = of_parse_phandle(np, "memory-region", idx);
+	if (rmem_np && of_find_property(rmem_np, "reusable", NULL)) {
+		dev_warn(dev, "cluster: memory-region %s is reusable, bulk writes disabled\n",
+			 RCAR_CLUSTER_BULK_REGION);
+		of_node_put(rmem_np);
+		return;
+	}
+	if (rmem_np)
+		rmem = of_reserved_mem_lookup(rmem_np);
+	of_node_put(rmem_np);
+	if (!rmem) {
+		dev_warn(dev, "cluster: memory-region %s not found, bulk writes disabled\n",
+			 RCAR_CLUSTER_BULK_REGION);
+		return;
+	}
+
+	/*
+	 * The rpmsg device comes without a DMA mask and dma_alloc_coherent()
+	 * warns without one. All allocations are served from the pool of the
+	 * region, so the mask does not restrict anything, allow all of it.
+	 */
+	ret = dma_coerce_mask_and_coherent(dev, DMA_BIT_MASK(64));
+	if (!ret)
+		ret = of_reserved_mem_device_init_by_idx(dev, np, idx);
+	if (ret) {
+		dev_warn(dev, "cluster: failed to init memory-region (%d), bulk writes disabled\n", ret);
+		return;
+	}
+
+	clusterdvc->rmem = rmem;
+	clusterdvc->rmem_dma = phys_to_dma(dev, rmem->base);
+	dev_info(dev, "cluster: bulk region %pa size %pa\n", &rmem->base, &rmem->size);
+}
+
+static void cluster_bulk_exit(rcar_cluster_device_t *clusterdvc)
+{
+	if (clusterdvc->rmem) {
+		of_reserved_mem_device_release(&clusterdvc->rpdev->dev);
+		clusterdvc->rmem = NULL;
+	}
+}
+
+static int rpmsg_ctrldev_release(struct inode *inode, struct file *filp)
+{
+	rcar_cluster_eptdev_t *clusterept= cdev_to_rcar_eptdev(inode->i_cdev);
+
+	put_device(&clusterept->dev);
+
+	return 0;
+}
+
+static int rpmsg_ctrldev_open(struct inode *inode, struct file *filp)
+{
+	void * p=NULL;
+	rcar_cluster_device_t *clusterdev = cdev_to_clusterdev(inode->i_cdev);
+
+	p = get_device(&clusterdev->dev);
+	filp->private_data = clusterdev;
+	return 0;
+}
+
+/* Sum up one class (or bulk kind) of all cpus, copying one row per cpu at a time */
+static void cluster_latency_sum(rcar_cluster_device_t *clusterdvc, bool bulk,
+				unsigned int class, rcar_cluster_latency_t *lat)
+{
+	rcar_cluster_latency_t row;
+	unsigned int start;
+	int cpu;
+
+	memset(lat, 0, sizeof(*lat));
+	for_each_possible_cpu(cpu) {
+		const rcar_cluster_stats_t *stats = per_cpu_ptr(clusterdvc->stats, cpu);
+
+		do {
+			start = u64_stats_fetch_begin(&stats->syncp);
+			row = bulk ? stats->bulk[class] : stats->latency[class];
+		} while (u64_stats_fetch_retry(&stats->syncp, start));
+
+		lat->count += row.count;
+		lat->queue_ns += row.queue_ns;
+		lat->transport_ns += row.transport_ns;
+		lat->processing_ns += row.processing_ns;
+		lat->rejected += row.rejected;
+	}
+}
+
+static ssize_t latency_show(struct device *dev,
+			    struct device_attribute *attr, char *buf)
+{
+	rcar_cluster_device_t *clusterdvc = dev_to_clusterdev(dev);
+	rcar_cluster_latency_t lat;
+	ssize_t len = 0;
+	unsigned int class, start;
+	u64 echo = 0, cpu_echo;
+	int cpu;
+
+	len += scnprintf(buf + len, PAGE_SIZE - len,
+			 "class count queue_ns transport_ns processing_ns rejected\n");
+
+	/* signal classes by number, then bulk kinds as bulkN */
+	for (class = 0; class < RCAR_CLUSTER_SIGNAL_CLASSES + RCAR_CLUSTER_BULK_KINDS; class++) {
+		bool bulk = class >= RCAR_CLUSTER_SIGNAL_CLASSES;
+		unsigned int idx = bulk ? class - RCAR_CLUSTER_SIGNAL_CLASSES : class;
+
+		cluster_latency_sum(clusterdvc, bulk, idx, &lat);
+		if (!lat.count && !lat.rejected)
+			continue;
+
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%s%u %llu %llu %llu %llu %llu\n",
+				 bulk ? "bulk" : "", idx, lat.count,
+				 lat.count ? div64_u64(lat.queue_ns, lat.count) : 0,
+				 lat.count ? div64_u64(lat.transport_ns, lat.count) : 0,
+				 lat.count ? div64_u64(lat.processing_ns, lat.count) : 0,
+				 lat.rejected);
+	}
+
+	for_each_possible_cpu(cpu) {
+		const rcar_cluster_stats_t *stats = per_cpu_ptr(clusterdvc->stats, cpu);
+
+		do {
+			start = u64_stats_fetch_begin(&stats->syncp);
+			cpu_echo = stats->echo_count;
+		} while (u64_stats_fetch_retry(&stats->syncp, start));
+		echo += cpu_echo;
+	}
+
+	len += scnprintf(buf + len, PAGE_SIZE - len, "echo %llu\n", echo);
+
+	return len;
+}
+static DEVICE_ATTR_RO(latency);
+
+static struct attribute *rpmsg_ctrldev_attrs[] = {
+	&dev_attr_latency.attr,
+	NULL
+};
+ATTRIBUTE_GROUPS(rpmsg_ctrldev);
+
+static void rpmsg_clusterdev_release_device(struct device *dev)
+{
+	rcar_cluster_device_t *clusterdvc = dev_to_clusterdev(dev);
+
+	ida_simple_remove(&rpmsg_ctrl_ida, dev->id);
+	ida_simple_remove(&rpmsg_minor_ida, MINOR(dev->devt));
+	free_percpu(clusterdvc->stats);
+	free_percpu(clusterdvc->txid);
+	kfree(clusterdvc);
+}
+
+/* -----------------------------------------------------------------------------
+ * Busy polling
+ */
+
+static void cluster_busy_poll_set(rcar_cluster_busy_poll_t *poll, unsigned int us)
+{
+	unsigned int max_ns = min_t(unsigned int, us, USEC_PER_SEC) * NSEC_PER_USEC;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(poll->wait); i++) {
+		WRITE_ONCE(poll->wait[i].avg_ns, 0);
+		WRITE_ONCE(poll->wait[i].budget_ns, max_ns);
+	}
+	WRITE_ONCE(poll->max_ns, max_ns);
+}
+
+/*
+ * Track the response time and spin for about twice the average, as long as
+ * the responses arrive within max_ns. Slower responses halve the budget so a
+ * busy TAURUS does not burn guest cpu.
+ */
+static void cluster_busy_poll_adapt(rcar_cluster_busy_poll_t *poll,
+				    rcar_cluster_busy_poll_wait_t *wait, u64 elapsed)
+{
+	unsigned int max_ns = READ_ONCE(poll->max_ns);
+	unsigned int avg = READ_ONCE(wait->avg_ns);
+	unsigned int budget;
+
+	if (elapsed <= max_ns) {
+		avg = avg ? avg - avg / 8 + (unsigned int)elapsed / 8 : elapsed;
+		WRITE_ONCE(wait->avg_ns, avg);
+		budget = clamp_t(unsigned int, 2 * avg, BUSY_POLL_MIN_NS, max_ns);
+	} else {
+		budget = max_t(unsigned int, READ_ONCE(wait->budget_ns) / 2, BUSY_POLL_MIN_NS);
+	}
+	WRITE_ONCE(wait->budget_ns, budget);
+}
+
+/*
+ * Sleep for the completion, interruptibly or, with a timeout in jiffies, for
+ * at most timeout. The latter is used from the timed queue work, which gets
+ * no signals and must not hang on a lost response.
+ */
+static int cluster_sleep(struct completion *done, unsigned long timeout)
+{
+	if (!timeout)
+		return wait_for_completion_interruptible(done);
+
+	return wait_for_completion_timeout(done, timeout) ? 0 : -ETIMEDOUT;
+}
+
+/* kind is RCAR_CLUSTER_WAIT_xxx, each kind adapts its spin budget separately */
+static int cluster_wait(struct completion *done, rcar_cluster_busy_poll_t *poll,
+			unsigned int kind, unsigned long timeout)
+{
+	rcar_cluster_busy_poll_wait_t *wait;
+	u64 start, budget;
+	int ret;
+
+	if (!poll || !READ_ONCE(poll->max_ns))
+		return cluster_sleep(done, timeout);
+
+	wait = &poll->wait[kind];
+	start = ktime_get_ns();
+	budget = READ_ONCE(wait->budget_ns);
+	do {
+		if (try_wait_for_completion(done)) {
+			atomic_long_inc(&poll->hits);
+			cluster_busy_poll_adapt(poll, wait, ktime_get_ns() - start);
+			return 0;
+		}
+		if (need_resched() || signal_pending(current))
+			break;
+		cpu_relax();
+	} while (ktime_get_ns() - start < budget);
+
+	atomic_long_inc(&poll->misses);
+	ret = cluster_sleep(done, timeout);
+	if (!ret)
+		cluster_busy_poll_adapt(poll, wait, ktime_get_ns() - start);
+
+	return ret;
+}
+
+static void cluster_latency_account(rcar_cluster_device_t *clusterdrv,
+				    const R_TAURUS_CmdMsg_t *msg,
+				    const struct taurus_event_list *event,
+				    u64 enqueue_ns, u64 sent_ns)
+{
+	unsigned int class = r_taurus_cluster_msg_class(msg);
+	bool bulk = msg->Cmd == R_TAURUS_CMD_WRITE;
+	const r_taurus_txn_t *txn = &event->txn;
+	rcar_cluster_stats_t *stats;
+	rcar_cluster_latency_t *lat;
+	u64 submit_ns = msg->Par3;
+
+	if (class >= (bulk ? RCAR_CLUSTER_BULK_KINDS : RCAR_CLUSTER_SIGNAL_CLASSES) ||
+	    !txn->AckNs || !txn->DoneNs)
+		return;
+
+	stats = get_cpu_ptr(clusterdrv->stats);
+	u64_stats_update_begin(&stats->syncp);
+
+	lat = bulk ? &stats->bulk[class] : &stats->latency[class];
+	if (txn->Rejected) {
+		lat->rejected++;
+		goto out;
+	}
+
+	lat->count++;
+	lat->queue_ns += sent_ns - enqueue_ns;
+	lat->transport_ns += txn->AckNs - submit_ns;
+	lat->processing_ns += txn->DoneNs - txn->AckNs;
+
+	if (txn->AckAux == submit_ns)
+		stats->echo_count++;
+
+out:
+	u64_stats_update_end(&stats->syncp);
+	put_cpu_ptr(clusterdrv->stats);
+}
+
+static rcar_cluster_event_bucket_t *cluster_event_bucket(rcar_cluster_device_t *clusterdrv,
+							 uint32_t id)
+{
+	return &clusterdrv->events[r_taurus_txn_bucket(id, RCAR_CLUSTER_EVENT_BUCKETS)];
+}
+
+/*
+ * Send a command and wait for its ACK and COMPLETE. timeout 0 waits
+ * interruptibly, otherwise the command fails with ETIMEDOUT if either result
+ * does not arrive within timeout jiffies and it does not wait for a free tx
+ * buffer.
+ */
+static int send_cmd(struct rpmsg_device *rpdev, R_TAURUS_CmdMsg_t *msg, taurus_cluster_res_msg_t* res_msg,
+		    rcar_cluster_busy_poll_t *poll, unsigned long timeout) {
+	int ret = 0;
+	struct taurus_event_list event;
+	rcar_cluster_event_bucket_t *bucket;
+	unsigned long flags;
+	u64 enqueue_ns = ktime_get_ns(), sent_ns;
+
+	rcar_cluster_device_t *clusterdrv = (rcar_cluster_device_t*)dev_get_drvdata(&rpdev->dev);
+
+	if(!clusterdrv){
+		dev_err(&rpdev->dev, "%s:%d Can't get data type rcar_cluster_device*\n", __FUNCTION__, __LINE__);
+		return -ENODEV;
+	}
+
+	msg->Id = cluster_taurus_get_uniq_id(clusterdrv);
+
+	/*
+	 * The event stays on this stack frame, it is unhashed under the bucket
+	 * lock before returning, after which the rx callback cannot see it.
+	 */
+	memset(&event.result, 0, sizeof(event.result));
+	r_taurus_txn_init(&event.txn, msg->Id);
+	init_completion(&event.ack);
+	init_completion(&event.completed);
+
+	bucket = cluster_event_bucket(clusterdrv, msg->Id);
+	spin_lock_irqsave(&bucket->lock, flags);
+	r_taurus_txn_link(&bucket->txns, &event.txn);
+	spin_unlock_irqrestore(&bucket->lock, flags);
+
+	msg->Par3 = ktime_get_ns();
+	cluster_capture(clusterdrv, RCAR_CLUSTER_CAPTURE_TX, msg, sizeof(*msg));
+	if (timeout)
+		ret = rpmsg_trysend(rpdev->ept, msg, sizeof(*msg));
+	else
+		ret = rpmsg_send(rpdev->ept, msg, sizeof(*msg));
+	sent_ns = ktime_get_ns();
+	
+	if (ret){
+		dev_err(&rpdev->dev, "rpmsg_send failed: %d\n", ret);
+		goto end;
+	}
+	
+	ret = cluster_wait(&event.ack, poll, RCAR_CLUSTER_WAIT_ACK, timeout);
+	if (ret) {
+		/* interrupted (-ERESTARTSYS) or no answer in time (-ETIMEDOUT) */
+		dev_err_ratelimited(&rpdev->dev, "%s:%d No taurus ACK for Id %u (%d)\n",
+				    __FUNCTION__, __LINE__, msg->Id, ret);
+		goto end;
+	}
+	ret = cluster_wait(&event.completed, poll, RCAR_CLUSTER_WAIT_COMPLETE, timeout);
+	if (ret) {
+		dev_err_ratelimited(&rpdev->dev, "%s:%d No taurus response for Id %u (%d)\n",
+				    __FUNCTION__, __LINE__, msg->Id, ret);
+		goto end;
+	}
+	else {
+		memcpy(res_msg, &event.result, sizeof(taurus_cluster_res_msg_t));
+		cluster_latency_account(clusterdrv, msg, &event, enqueue_ns, sent_ns);
+	}
+
+end:
+	spin_lock_irqsave(&bucket->lock, flags);
+	r_taurus_txn_unlink(&event.txn);
+	spin_unlock_irqrestore(&bucket->lock, flags);
+
+	return ret;
+}
+
+static int send_msg(struct rpmsg_device *rpdev, taurus_cluster_data_t *data, taurus_cluster_res_msg_t* res_msg,
+		    rcar_cluster_busy_poll_t *poll, unsigned long timeout) {
+	R_TAURUS_CmdMsg_t msg;
+
+	/* Par3 is the submit time stamp, set by send_cmd() */
+	r_taurus_cluster_encode(&msg, data);
+
+	return send_cmd(rpdev, &msg, res_msg, poll, timeout);
+}
+
+static int send_bulk(struct rpmsg_device *rpdev, taurus_cluster_bulk_t *bulk,
+		     rcar_cluster_busy_poll_t *poll)
+{
+	rcar_cluster_device_t *clusterdrv = dev_get_drvdata(&rpdev->dev);
+	struct reserved_mem *rmem = clusterdrv->rmem;
+	R_TAURUS_CmdMsg_t msg;
+	taurus_cluster_res_msg_t res;
+	dma_addr_t dma;
+	void *buf;
+	int ret;
+
+	if (!rmem)
+		return -ENODEV;
+
+	if (!bulk->len || bulk->len > rmem->size)
+		return -EINVAL;
+
+	buf = dma_alloc_coherent(&rpdev->dev, bulk->len, &dma, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	/* TAURUS only sees the region, the buffer must not come from elsewhere */
+	if (dma < clusterdrv->rmem_dma ||
+	    dma + bulk->len > clusterdrv->rmem_dma + rmem->size) {
+		dev_warn_ratelimited(&rpdev->dev, "cluster: bulk buffer %pad outside of region\n",
+				     &dma);
+		ret = -ENOMEM;
+		goto free_buf;
+	}
+
+	if (copy_from_user(buf, u64_to_user_ptr(bulk->buf), bulk->len)) {
+		ret = -EFAULT;
+		goto free_buf;
+	}
+
+	r_taurus_cluster_encode_bulk(&msg, bulk->ioctl_cmd, dma - clusterdrv->rmem_dma,
+				     bulk->len);
+
+	ret = send_cmd(rpdev, &msg, &res, poll, 0);
+	if (!ret && r_taurus_cluster_rejected(&res.hdr))
+		ret = -EIO;
+
+free_buf:
+	dma_free_coherent(&rpdev->dev, bulk->len, buf, dma);
+	return ret;
+}
+
+/*
+ * Send a value and retransmit it while TAURUS answers with NACK or ERROR,
+ * up to retry_budget[] times with exponential backoff. A retransmission is
+ * dropped once a newer value of the same signal class has been submitted.
+ * Timed sends (timeout != 0, see send_cmd()) are not retransmitted, the
+ * retry would make the entries due after them late.
+ */
+static int cluster_send(struct rpmsg_device *rpdev, taurus_cluster_data_t *data,
+			rcar_cluster_busy_poll_t *poll, unsigned long timeout)
+{
+	rcar_cluster_device_t *clusterdrv = dev_get_drvdata(&rpdev->dev);
+	unsigned int class = data->ioctl_cmd;
+	unsigned int retries = 0, backoff_us = 0;
+	taurus_cluster_res_msg_t res;
+	int seq = 0;
+	int ret;
+
+	if (class < RCAR_CLUSTER_SIGNAL_CLASSES) {
+		seq = atomic_inc_return(&clusterdrv->signal_seq[class]);
+		if (!timeout) {
+			retries = READ_ONCE(retry_budget[class]);
+			backoff_us = READ_ONCE(retry_backoff_us[class]);
+		}
+	}
+
+	for (;;) {
+		ret = send_msg(rpdev, data, &res, poll, timeout);
+		if (ret)
+			return ret;
+
+		if (!r_taurus_cluster_rejected(&res.hdr))
+			return 0;
+
+		if (!retries--) {
+			dev_dbg(&rpdev->dev, "%s:%d signal %u rejected (%u), giving up\n",
+				__FUNCTION__, __LINE__, class, res.hdr.Result);
+			return -EIO;
+		}
+
+		fsleep(backoff_us);
+		if (signal_pending(current))
+			return -ERESTARTSYS;
+
+		if (atomic_read(&clusterdrv->signal_seq[class]) != seq) {
+			dev_dbg(&rpdev->dev, "%s:%d signal %u superseded, retry dropped\n",
+				__FUNCTION__, __LINE__, class);
+			return 0;
+		}
+
+		backoff_us = min(backoff_us * 2, READ_ONCE(retry_backoff_max_us));
+	}
+}
+
+/* -----------------------------------------------------------------------------
+ * RPMSG operations
+ */
+
+static int rpmsg_cluster_cb(struct rpmsg_device* rpdev, void* data, int len,
+			void* priv, u32 src) {
+	int ret = 0;
+	struct taurus_event_list* event = NULL;
+	struct taurus_cluster_res_msg* res = (struct taurus_cluster_res_msg*)data;
+	rcar_cluster_event_bucket_t *bucket;
+	r_taurus_txn_t *txn;
+	int state;
+	unsigned long flags;
+	rcar_cluster_device_t* clusterdrv = (rcar_cluster_device_t*)dev_get_drvdata(&rpdev->dev);
+	uint32_t res_id = res->hdr.Id;
+	u64 now = ktime_get_ns();
+
+	cluster_capture(clusterdrv, RCAR_CLUSTER_CAPTURE_RX, data, len);
+
+	if (!r_taurus_cluster_unsolicited(&res->hdr)) {/*necessary send data to cluster*/
+		/*send ACK message*/
+		bucket = cluster_event_bucket(clusterdrv, res_id);
+		spin_lock_irqsave(&bucket->lock, flags);
+		
+		state = r_taurus_txn_match(&bucket->txns, &res->hdr, now, &txn);
+		if (state != R_TAURUS_TXN_NONE) {
+			event = container_of(txn, struct taurus_event_list, txn);
+			memcpy(&event->result, data, min_t(size_t, len, sizeof(event->result)));
+		}
+
+		switch (state) {
+		case R_TAURUS_TXN_REJECTED:
+			/* no COMPLETE will follow, release the sender */
+			complete(&event->ack);
+			complete(&event->completed);
+			break;
+		case R_TAURUS_TXN_COMPLETE:
+			dev_info(&rpdev->dev, "%s:%d Message completed (%d)\n", __FUNCTION__, __LINE__, ret);
+			complete(&event->completed);
+			break;
+		case R_TAURUS_TXN_ACK:
+			complete(&event->ack);
+			break;
+		}
+		spin_unlock_irqrestore(&bucket->lock, flags);
+	}
+	return 0;
+}
+
+static int rpmsg_cluster_probe(struct rpmsg_device* rpdev)
+{
+	rcar_cluster_device_t *clusterdvc = NULL;
+	int ret = 0, i, cpu;
+	struct device *dev = NULL;
+	taurus_cluster_res_msg_t res_msg;
+
+	taurus_cluster_data_t cluster_data = {
+		.value = 10,
+		.ioctl_cmd = 1,
+	};
+	dev_info(&rpdev->dev, "cluster: %s:%d probe\n", __FUNCTION__, __LINE__);
+
+	clusterdvc = kzalloc(sizeof(*clusterdvc), GFP_KERNEL);
+
+	if (clusterdvc== NULL)
+		return -ENOMEM;
+
+	clusterdvc->txid = alloc_percpu(rcar_cluster_txid_t);
+	clusterdvc->stats = alloc_percpu(rcar_cluster_stats_t);
+	if (!clusterdvc->txid || !clusterdvc->stats) {
+		free_percpu(clusterdvc->stats);
+		free_percpu(clusterdvc->txid);
+		kfree(clusterdvc);
+		return -ENOMEM;
+	}
+	for_each_possible_cpu(cpu)
+		u64_stats_init(&per_cpu_ptr(clusterdvc->stats, cpu)->syncp);
+	
+	clusterdvc->rpdev = rpdev;
+	dev = &clusterdvc->dev;
+	
+	device_initialize(dev);
+
+	dev->parent = &rpdev->dev;
+	dev->class = rpmsg_class;
+	dev->groups = rpmsg_ctrldev_groups;
+	
+	cdev_init(&clusterdvc->cdev, &rpmsg_ctrldev_fops);
+
+	clusterdvc->cdev.owner = THIS_MODULE;
+	ret = ida_simple_get(&rpmsg_minor_ida, 0, RPMSG_DEV_MAX, GFP_KERNEL);
+	if (ret < 0) {
+		goto free_clusterdvc;
+	}
+	
+	clusterdvc->dev.devt = MKDEV(MAJOR(rpmsg_major), ret);
+
+	ret = ida_simple_get(&rpmsg_ctrl_ida, 0, 0, GFP_KERNEL);
+	if (ret < 0){
+		goto free_minor_ida;
+	}
+	
+	clusterdvc->dev.id = ret;
+
+	dev_set_name(&clusterdvc->dev, "rpmsg_ctrl%d", ret);
+	ret = cdev_device_add(&clusterdvc->cdev, &clusterdvc->dev);
+	if (ret) {
+		goto free_ctrl_ida;
+	}
+
+	/* We can now rely on the function for cleanup */
+	clusterdvc->dev.release = rpmsg_clusterdev_release_device;
+	cluster_capture_init(clusterdvc);
+	cluster_bulk_init(clusterdvc);
+
+	/* ready before drvdata makes the device visible to the rx callback */
+	for (i = 0; i < RCAR_CLUSTER_EVENT_BUCKETS; i++) {
+		spin_lock_init(&clusterdvc->events[i].lock);
+		clusterdvc->events[i].txns.Head = NULL;
+	}
+	dev_set_drvdata(&rpdev->dev, clusterdvc);
+	
+	/*send a ping of message with dummy data*/
+	send_msg(rpdev, &cluster_data, &res_msg, NULL, 0);
+
+	return ret;
+
+free_ctrl_ida:
+	ida_simple_remove(&rpmsg_ctrl_ida, clusterdvc->dev.id);
+free_minor_ida:
+	ida_simple_remove(&rpmsg_minor_ida, MINOR(clusterdvc->dev.devt));
+free_clusterdvc:
+	put_device(&clusterdvc->dev);
+	free_percpu(clusterdvc->stats);
+	free_percpu(clusterdvc->txid);
+	kfree(clusterdvc);	
+
+	return ret;
+}
+
+/* -----------------------------------------------------------------------------
+ * Timed transmission queue
+ */
+
+/* Called with timed_lock held */
+static void cluster_timed_arm(rcar_cluster_eptdev_t *eptdev)
+{
+	rcar_cluster_timed_entry_t *first;
+
+	first = list_first_entry_or_null(&eptdev->timed_list,
+					 rcar_cluster_timed_entry_t, list);
+	if (first)
+		hrtimer_start(&eptdev->timed_timer, ns_to_ktime(first->due_ns),
+			      HRTIMER_MODE_ABS);
+}
+
+static enum hrtimer_restart cluster_timed_expired(struct hrtimer *timer)
+{
+	rcar_cluster_eptdev_t *eptdev = container_of(timer, rcar_cluster_eptdev_t, timed_timer);
+
+	queue_work(eptdev->timed_wq, &eptdev->timed_work);
+	return HRTIMER_NORESTART;
+}
+
+static void cluster_timed_work(struct work_struct *work)
+{
+	rcar_cluster_eptdev_t *eptdev = container_of(work, rcar_cluster_eptdev_t, timed_work);
+	u64 limit = ktime_get_ns() + (u64)READ_ONCE(timed_batch_us) * NSEC_PER_USEC;
+	unsigned long timeout = max_t(unsigned long, msecs_to_jiffies(READ_ONCE(timed_timeout_ms)), 1);
+	rcar_cluster_timed_entry_t *entry, *tmp;
+	unsigned long seen = 0;
+	unsigned int class;
+	LIST_HEAD(batch);
+
+	spin_lock(&eptdev->timed_lock);
+	list_for_each_entry_safe(entry, tmp, &eptdev->timed_list, list) {
+		if (entry->due_ns > limit)
+			break;
+		list_move_tail(&entry->list, &batch);
+		eptdev->timed_count--;
+	}
+	cluster_timed_arm(eptdev);
+	spin_unlock(&eptdev->timed_lock);
+
+	/* only the latest value of a signal in the batch is sent */
+	list_for_each_entry_reverse(entry, &batch, list) {
+		class = entry->data.ioctl_cmd;
+		if (class >= BITS_PER_LONG)
+			continue;
+		entry->superseded = test_bit(class, &seen);
+		__set_bit(class, &seen);
+	}
+
+	/* every value is still its own round trip, bounded by timeout */
+	list_for_each_entry_safe(entry, tmp, &batch, list) {
+		if (!entry->superseded &&
+		    (READ_ONCE(eptdev->timed_abort) ||
+		     cluster_send(eptdev->rpdev, &entry->data, &eptdev->poll, timeout)))
+			atomic_long_inc(&eptdev->timed_dropped);
+		list_del(&entry->list);
+		kfree(entry);
+	}
+}
+
+static int cluster_timed_init(rcar_cluster_eptdev_t *eptdev)
+{
+	/* one per endpoint, a slow TAURUS answer only delays its own entries */
+	eptdev->timed_wq = alloc_ordered_workqueue("rcar_cluster_timed", WQ_HIGHPRI);
+	if (!eptdev->timed_wq)
+		return -ENOMEM;
+
+	mutex_init(&eptdev->timed_mutex);
+	spin_lock_init(&eptdev->timed_lock);
+	INIT_LIST_HEAD(&eptdev->timed_list);
+	hrtimer_init(&eptdev->timed_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	eptdev->timed_timer.function = cluster_timed_expired;
+	INIT_WORK(&eptdev->timed_work, cluster_timed_work);
+	return 0;
+}
+
+/*
+ * timed_mutex keeps schedule calls from adding entries, and arming the
+ * timer, between emptying the list and cancelling the timer, and concurrent
+ * flushes from clearing timed_abort under each other.
+ */
+static void cluster_timed_flush(rcar_cluster_eptdev_t *eptdev)
+{
+	rcar_cluster_timed_entry_t *entry, *tmp;
+	LIST_HEAD(pending);
+
+	mutex_lock(&eptdev->timed_mutex);
+
+	spin_lock(&eptdev->timed_lock);
+	list_splice_init(&eptdev->timed_list, &pending);
+	eptdev->timed_count = 0;
+	spin_unlock(&eptdev->timed_lock);
+
+	/* the work finishes the value in flight, at most timed_timeout_ms each wait */
+	WRITE_ONCE(eptdev->timed_abort, true);
+	hrtimer_cancel(&eptdev->timed_timer);
+	cancel_work_sync(&eptdev->timed_work);
+	WRITE_ONCE(eptdev->timed_abort, false);
+
+	mutex_unlock(&eptdev->timed_mutex);
+
+	list_for_each_entry_safe(entry, tmp, &pending, list) {
+		list_del(&entry->list);
+		kfree(entry);
+	}
+}
+
+static int cluster_timed_schedule(rcar_cluster_eptdev_t *eptdev,
+				  taurus_cluster_schedule_t *sched)
+{
+	rcar_cluster_timed_entry_t *entry, *pos, *tmp;
+	taurus_cluster_timed_t *timed;
+	unsigned int i;
+	LIST_HEAD(batch);
+	int ret = 0;
+
+	if (!sched->count || sched->count > RCAR_CLUSTER_SCHEDULE_MAX)
+		return -EINVAL;
+
+	timed = memdup_user(u64_to_user_ptr(sched->entries),
+			    sched->count * sizeof(*timed));
+	if (IS_ERR(timed))
+		return PTR_ERR(timed);
+
+	for (i = 0; i < sched->count; i++) {
+		entry = kzalloc(sizeof(*entry), GFP_KERNEL);
+		if (!entry) {
+			ret = -ENOMEM;
+			goto free_batch;
+		}
+		entry->due_ns = timed[i].due_ns;
+		entry->data = timed[i].data;
+		list_add_tail(&entry->list, &batch);
+	}
+
+	mutex_lock(&eptdev->timed_mutex);
+	spin_lock(&eptdev->timed_lock);
+	if (eptdev->timed_count + sched->count > READ_ONCE(timed_queue_max)) {
+		spin_unlock(&eptdev->timed_lock);
+		mutex_unlock(&eptdev->timed_mutex);
+		ret = -ENOSPC;
+		goto free_batch;
+	}
+
+	/* insertion sort from the tail, entries usually arrive in due order */
+	list_for_each_entry_safe(entry, tmp, &batch, list) {
+		list_for_each_entry_reverse(pos, &eptdev->timed_list, list)
+			if (pos->due_ns <= entry->due_ns)
+				break;
+		list_move(&entry->list, &pos->list);
+	}
+	eptdev->timed_count += sched->count;
+	cluster_timed_arm(eptdev);
+	spin_unlock(&eptdev->timed_lock);
+	mutex_unlock(&eptdev->timed_mutex);
+
+	kfree(timed);
+	return 0;
+
+free_batch:
+	list_for_each_entry_safe(entry, tmp, &batch, list)
+		kfree(entry);
+	kfree(timed);
+	return ret;
+}
+
+static int rpmsg_eptdev_destroy(struct device *dev, void *data)
+{
+	rcar_cluster_eptdev_t *eptdev = dev_to_rcar_eptdev(dev);
+
+	cluster_timed_flush(eptdev);
+
+	/*mutex_lock(&eptdev->ept_lock);*/
+	if (eptdev->ept) {
+		rpmsg_destroy_ept(eptdev->ept);
+		eptdev->ept = NULL;
+	}
+	/*mutex_unlock(&eptdev->ept_lock);*/
+
+	/* wake up any blocked readers */
+	/*wake_up_interruptible(&eptdev->readq);*/
+
+	cdev_device_del(&eptdev->cdev, &eptdev->dev);
+	put_device(&eptdev->dev);
+
+	return 0;
+}
+
+static void rpmsg_cluster_remove(struct rpmsg_device *rpdev)
+{
+	rcar_cluster_device_t *data = dev_get_drvdata(&rpdev->dev);
+	int ret = 0;
+
+	ret = device_for_each_child(&data->dev, NULL, rpmsg_eptdev_destroy);
+	if (ret)
+		dev_warn(&rpdev->dev, "failed to nuke endpoints: %d\n", ret);
+
+	cluster_capture_exit(data);
+	cluster_bulk_exit(data);
+	cdev_device_del(&data->cdev, &data->dev);
+	put_device(&data->dev);
+	
+    return;
+}
+
+static int __init cluster_drv_init(void)
+{
+	int ret = 0;
+
+    ret = alloc_chrdev_region(&rpmsg_major, 0, RPMSG_DEV_MAX, "rpmsg");
+	if (ret < 0) {
+		pr_err("failed to allocate char dev region\n");
+		return ret;
+	}
+
+	rpmsg_class = class_create(THIS_MODULE, "rpmsg");
+	
+	if (IS_ERR(rpmsg_class)) {
+		pr_err("failed to create rpmsg class\n");
+		unregister_chrdev_region(rpmsg_major, RPMSG_DEV_MAX);
+		return PTR_ERR(rpmsg_class);
+	}
+
+	cluster_debugfs_root = debugfs_create_dir("rcar_cluster", NULL);
+
+	ret =  register_rpmsg_driver(&rpmsg_cluster_drv);
+	if (ret < 0) {
+		pr_err("failed to register cluster_drv_init driver\n");
+		debugfs_remove_recursive(cluster_debugfs_root);
+		class_destroy(rpmsg_class);
+		unregister_chrdev_region(rpmsg_major, RPMSG_DEV_MAX);
+	}
+
+	return ret;
+}
+postcore_initcall(cluster_drv_init);
+
+static void __exit cluster_drv_exit(void)
+{
+    unregister_rpmsg_driver(&rpmsg_cluster_drv);
+	debugfs_remove_recursive(cluster_debugfs_root);
+	class_destroy(rpmsg_class);
+	unregister_chrdev_region(rpmsg_major, RPMSG_DEV_MAX);
+}
+
+static ssize_t busy_poll_us_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	rcar_cluster_eptdev_t *eptdev = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%u\n", READ_ONCE(eptdev->poll.max_ns) / NSEC_PER_USEC);
+}
+
+static ssize_t busy_poll_us_store(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t len)
+{
+	rcar_cluster_eptdev_t *eptdev = dev_get_drvdata(dev);
+	unsigned int us;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &us);
+	if (ret)
+		return ret;
+
+	cluster_busy_poll_set(&eptdev->poll, us);
+	return len;
+}
+static DEVICE_ATTR_RW(busy_poll_us);
+
+static ssize_t busy_poll_budget_ns_show(struct device *dev,
+					struct device_attribute *attr, char *buf)
+{
+	rcar_cluster_eptdev_t *eptdev = dev_get_drvdata(dev);
+
+	/* ACK and COMPLETE spin budget */
+	return sprintf(buf, "%u %u\n",
+		       READ_ONCE(eptdev->poll.wait[RCAR_CLUSTER_WAIT_ACK].budget_ns),
+		       READ_ONCE(eptdev->poll.wait[RCAR_CLUSTER_WAIT_COMPLETE].budget_ns));
+}
+static DEVICE_ATTR_RO(busy_poll_budget_ns);
+
+static ssize_t busy_poll_hits_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	rcar_cluster_eptdev_t *eptdev = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%ld\n", atomic_long_read(&eptdev->poll.hits));
+}
+static DEVICE_ATTR_RO(busy_poll_hits);
+
+static ssize_t busy_poll_misses_show(struct device *dev,
+				     struct device_attribute *attr, char *buf)
+{
+	rcar_cluster_eptdev_t *eptdev = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%ld\n", atomic_long_read(&eptdev->poll.misses));
+}
+static DEVICE_ATTR_RO(busy_poll_misses);
+
+static ssize_t timed_dropped_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	rcar_cluster_eptdev_t *eptdev = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%ld\n", atomic_long_read(&eptdev->timed_dropped));
+}
+static DEVICE_ATTR_RO(timed_dropped);
+
+static struct attribute *rpmsg_eptdev_attrs[] = {
+	&dev_attr_busy_poll_us.attr,
+	&dev_attr_busy_poll_budget_ns.attr,
+	&dev_attr_busy_poll_hits.attr,
+	&dev_attr_busy_poll_misses.attr,
+	&dev_attr_timed_dropped.attr,
+	NULL
+};
+ATTRIBUTE_GROUPS(rpmsg_eptdev);
+
+static void rpmsg_eptdev_release_device(struct device *dev)
+{
+	rcar_cluster_eptdev_t *eptdev = dev_to_rcar_eptdev(dev);
+
+	cluster_timed_flush(eptdev);
+	destroy_workqueue(eptdev->timed_wq);
+	ida_simple_remove(&rpmsg_ept_ida, dev->id);
+	ida_simple_remove(&rpmsg_minor_ida, MINOR(eptdev->dev.devt));
+	kfree(eptdev);
+}
+
+static int rpmsg_eptdev_create(rcar_cluster_device_t *clusterdvc,
+			       struct rpmsg_channel_info chinfo)
+{
+	struct rpmsg_device *rpdev = clusterdvc->rpdev;
+	rcar_cluster_eptdev_t *eptdev;
+	struct device *dev;
+	int ret;
+
+	eptdev = kzalloc(sizeof(*eptdev), GFP_KERNEL);
+	if (!eptdev)
+		return -ENOMEM;
+
+	dev = &eptdev->dev;
+	eptdev->rpdev = rpdev;
+	eptdev->chinfo = chinfo;
+	eptdev->ept = clusterdvc->ept;
+	cluster_busy_poll_set(&eptdev->poll, READ_ONCE(busy_poll_us));
+	ret = cluster_timed_init(eptdev);
+	if (ret) {
+		kfree(eptdev);
+		return ret;
+	}
+
+	/*mutex_init(&eptdev->ept_lock);
+	spin_lock_init(&eptdev->queue_lock);
+	skb_queue_head_init(&eptdev->queue);
+	init_waitqueue_head(&eptdev->readq);
+*/
+	device_initialize(dev);
+
+	dev->class = rpmsg_class;
+	dev->parent = &clusterdvc->dev;
+	dev->groups = rpmsg_eptdev_groups;
+	dev_set_drvdata(dev, eptdev);
+
+	cdev_init(&eptdev->cdev, &rpmsg_eptdev_fops);
+	eptdev->cdev.owner = THIS_MODULE;
+
+	ret = ida_simple_get(&rpmsg_minor_ida, 0, RPMSG_DEV_MAX, GFP_KERNEL);
+	if (ret < 0){
+		goto free_eptdev;
+	};
+	dev->devt = MKDEV(MAJOR(rpmsg_major), ret);
+
+	ret = ida_simple_get(&rpmsg_ept_ida, 0, 0, GFP_KERNEL);
+	if (ret < 0){
+		goto free_minor_ida;
+	}
+	dev->id = ret;
+	dev_set_name(dev, "rpmsg%d", ret);
+	
+	ret = cdev_device_add(&eptdev->cdev, &eptdev->dev);
+	if (ret){
+		goto free_ept_ida;
+	}	
+	/* We can now rely on the release function for cleanup */
+	dev->release = rpmsg_eptdev_release_device;
+	return ret;
+
+free_ept_ida:
+	ida_simple_remove(&rpmsg_ept_ida, dev->id);
+free_minor_ida:
+	ida_simple_remove(&rpmsg_minor_ida, MINOR(dev->devt));
+free_eptdev:
+	put_device(dev);
+	destroy_workqueue(eptdev->timed_wq);
+	kfree(eptdev);
+
+	return ret;
+}
+
+static long rpmsg_ctrldev_ioctl(struct file *fp, unsigned int cmd,
+				unsigned long arg)
+{
+	rcar_cluster_device_t *clusterdvc = fp->private_data;
+	void __user *argp = (void __user *)arg;
+	struct rpmsg_endpoint_info eptinfo;
+	struct rpmsg_channel_info chinfo;
+
+	if (cmd != RPMSG_CREATE_EPT_IOCTL){
+		return -EINVAL;
+	}
+
+	if (copy_from_user(&eptinfo, argp, sizeof(eptinfo))){
+		return -EFAULT;
+	}
+	
+	memcpy(chinfo.name, eptinfo.name, RPMSG_NAME_SIZE);
+	chinfo.name[RPMSG_NAME_SIZE-1] = '\0';
+	chinfo.src = eptinfo.src;
+	chinfo.dst = eptinfo.dst;
+	
+	return rpmsg_eptdev_create(clusterdvc, chinfo);
+};
+
+static int rpmsg_eptdev_open(struct inode *inode, struct file *filp)
+{
+	rcar_cluster_eptdev_t *eptdev = cdev_to_rcar_eptdev(inode->i_cdev);
+	struct rpmsg_endpoint *ept;
+	struct device *dev = &eptdev->dev;
+
+	if (eptdev->ept){
+		return -EBUSY;
+	}
+
+	get_device(dev);
+
+	/*ept = rpmsg_create_ept(rpdev, rpmsg_ept_cb, eptdev, eptdev->chinfo);
+	if (!ept) {
+		dev_err(dev, "failed to open %s\n", eptdev->chinfo.name);
+		put_device(dev);
+		return -EINVAL;
+	}
+	*/
+	
+	eptdev->ept = ept;
+	filp->private_data = eptdev;
+
+	return 0;
+}
+
+
+static int rpmsg_eptdev_release(struct inode *inode, struct file *filp)
+{
+	rcar_cluster_eptdev_t *eptdev = cdev_to_rcar_eptdev(inode->i_cdev);/*cdev_to_eptdev(inode->i_cdev);*/
+	struct device *dev = &eptdev->dev;
+
+	cluster_timed_flush(eptdev);
+
+	/* Close the endpoint, if it's not already destroyed by the parent */
+	/*mutex_lock(&eptdev->ept_lock);*/
+	if (eptdev->ept) {
+		rpmsg_destroy_ept(eptdev->ept);
+		eptdev->ept = NULL;
+	}
+	/*mutex_unlock(&eptdev->ept_lock);8/
+
+	/ Discard all SKBs /
+	skb_queue_purge(&eptdev->queue);
+*/
+	put_device(dev);
+
+	return 0;
+}
+
+/* Values copied in from userspace at a time, any number may be written */
+#define CLUSTER_WRITE_CHUNK	32
+
+static ssize_t rpmsg_eptdev_write_iter(struct kiocb *iocb,
+				       struct iov_iter *from)
+{
+	struct file *filp = iocb->ki_filp;
+	rcar_cluster_eptdev_t *eptdev = filp->private_data;
+	size_t len = iov_iter_count(from);
+	taurus_cluster_data_t data[CLUSTER_WRITE_CHUNK];
+	size_t i, n, count, sent = 0;
+	int ret = 0;
+
+	/* a write carries one or more taurus_cluster_data_t */
+	if (!len || len % sizeof(*data))
+		return -EINVAL;
+	count = len / sizeof(*data);
+
+	if (!eptdev->ept)
+		return -EPIPE;
+
+	while (sent < count && !ret) {
+		n = min_t(size_t, count - sent, ARRAY_SIZE(data));
+		if (!copy_from_iter_full(data, n * sizeof(*data), from)) {
+			ret = -EFAULT;
+			break;
+		}
+
+		for (i = 0; i < n; i++) {
+			ret = cluster_send(eptdev->rpdev, &data[i], &eptdev->poll, 0);
+			if (ret)
+				break;
+			sent++;
+		}
+	}
+
+	/* report the values sent before a failed one as a short write */
+	if (ret < 0 && !sent)
+		return ret;
+	return sent * sizeof(*data);
+}
+
+static long rpmsg_eptdev_ioctl(struct file *fp, unsigned int cmd,
+			       unsigned long arg)
+{
+	rcar_cluster_eptdev_t *eptdev = fp->private_data;
+	taurus_cluster_bulk_t bulk;
+	taurus_cluster_schedule_t sched;
+	unsigned int us;
+
+	switch (cmd) {
+	case RPMSG_DESTROY_EPT_IOCTL:
+		return rpmsg_eptdev_destroy(&eptdev->dev, NULL);
+	case RCAR_CLUSTER_SET_BUSY_POLL_IOCTL:
+		if (get_user(us, (unsigned int __user *)arg))
+			return -EFAULT;
+		cluster_busy_poll_set(&eptdev->poll, us);
+		return 0;
+	case RCAR_CLUSTER_BULK_WRITE_IOCTL:
+		if (copy_from_user(&bulk, (void __user *)arg, sizeof(bulk)))
+			return -EFAULT;
+		return send_bulk(eptdev->rpdev, &bulk, &eptdev->poll);
+	case RCAR_CLUSTER_SCHEDULE_IOCTL:
+		if (copy_from_user(&sched, (void __user *)arg, sizeof(sched)))
+			return -EFAULT;
+		return cluster_timed_schedule(eptdev, &sched);
+	case RCAR_CLUSTER_FLUSH_SCHEDULE_IOCTL:
+		cluster_timed_flush(eptdev);
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+MODULE_DEVICE_TABLE(rpmsg, rpmsg_driver_cluster_id_table);
+
+/*module_rpmsg_driver(rpmsg_cluster_drv);*/
+
+/*module_init(cluster_drv_init);*/
+module_exit(cluster_drv_exit);
+MODULE_ALIAS("rpmsg_cluster:rpmsg_chrdev");
+MODULE_DESCRIPTION("Remote processor messaging cluster driver");
+MODULE_LICENSE("GPL v2");
@@ -0,0 +1,143 @@
+/*
+ * cluster_bench.c  --  multi-writer throughput benchmark for the R-Car Cluster driver
+ *
+ * Starts 1, 2, 4, ... up to N writer threads, all writing cluster values
+ * through the same endpoint device file, and reports aggregate throughput,
+ * its scaling relative to a single writer and the average write() latency
+ * for every thread count, so the scaling of the driver with concurrent writers can be
+ * compared between builds.
+ *
+ * Usage: cluster_bench [-d /dev/rpmsgN] [-t max_threads] [-n writes_per_thread]
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../r_taurus_cluster_core.h"
+
+typedef struct bench_thread {
+    pthread_t          thread;
+    int                fd;
+    unsigned int       id;
+    unsigned long      writes;
+    unsigned long      errors;
+    unsigned long long busy_ns;
+} bench_thread_t;
+
+static pthread_barrier_t start_barrier;
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void *bench_writer(void *arg)
+{
+    bench_thread_t *t = arg;
+    taurus_cluster_data_t data = { .ioctl_cmd = RCAR_IO_SPEED };
+    unsigned long n = t->writes;
+    unsigned long long t0;
+
+    t->writes = 0;
+    pthread_barrier_wait(&start_barrier);
+
+    t0 = now_ns();
+    while (n--) {
+        data.value = (int)((t->id * 40 + n) % 240);
+        if (write(t->fd, &data, sizeof(data)) == sizeof(data))
+            t->writes++;
+        else
+            t->errors++;
+    }
+    t->busy_ns = now_ns() - t0;
+
+    return NULL;
+}
+
+static int run(int fd, unsigned int threads, unsigned long writes)
+{
+    bench_thread_t *t = calloc(threads, sizeof(*t));
+    unsigned long total = 0, errors = 0;
+    unsigned long long busy = 0, t0, elapsed;
+    static double base_rate;
+    double rate;
+    unsigned int i;
+
+    if (!t)
+        return -1;
+
+    pthread_barrier_init(&start_barrier, NULL, threads + 1);
+    for (i = 0; i < threads; i++) {
+        t[i].fd = fd;
+        t[i].id = i;
+        t[i].writes = writes;
+        pthread_create(&t[i].thread, NULL, bench_writer, &t[i]);
+    }
+
+    pthread_barrier_wait(&start_barrier);
+    t0 = now_ns();
+    for (i = 0; i < threads; i++) {
+        pthread_join(t[i].thread, NULL);
+        total += t[i].writes;
+        errors += t[i].errors;
+        busy += t[i].busy_ns;
+    }
+    elapsed = now_ns() - t0;
+    pthread_barrier_destroy(&start_barrier);
+
+    rate = total * 1e9 / (double)(elapsed ? elapsed : 1);
+    if (threads == 1)
+        base_rate = rate;
+
+    printf("%3u writers: %9.1f writes/s  scaling %5.2fx  avg latency %7.1fus  errors %lu\n",
+           threads, rate, base_rate > 0 ? rate / base_rate : 0.0,
+           total ? busy / 1000.0 / total : 0.0, errors);
+
+    free(t);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *devname = "/dev/rpmsg0";
+    unsigned int max_threads = 8, threads;
+    unsigned long writes = 10000;
+    int opt, fd;
+
+    while ((opt = getopt(argc, argv, "d:t:n:")) != -1) {
+        switch (opt) {
+        case 'd':
+            devname = optarg;
+            break;
+        case 't':
+            max_threads = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            writes = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-d device] [-t max_threads] [-n writes]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    fd = open(devname, O_WRONLY);
+    if (fd < 0) {
+        perror(devname);
+        return 1;
+    }
+
+    for (threads = 1; threads <= max_threads; threads *= 2)
+        if (run(fd, threads, writes))
+            break;
+
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,223 @@
+/*
+ * cluster_replay.c  --  replay a R-Car Cluster traffic capture
+ *
+ * Reads the per-cpu capture files written by the driver (see
+ * rcar_cluster_capture.h), merges them by timestamp and sends every captured
+ * IOCTL command again through an endpoint device, either with the original
+ * timing, scaled by a rate factor, or as fast as possible.
+ *
+ * Usage: cluster_replay [-d /dev/rpmsgN] [-r rate] capture0 [capture1 ...]
+ *   -r 1    original timing (default)
+ *   -r 4    four times faster
+ *   -r 0    no delay between commands
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../r_taurus_cluster_protocol.h"
+#include "../rcar_cluster_capture.h"
+
+typedef struct replay_buf {
+    rcar_cluster_capture_rec_t *rec;
+    size_t                      count;
+    size_t                      size;
+} replay_buf_t;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t t)
+{
+    struct timespec ts;
+
+    ts.tv_sec = t / 1000000000ull;
+    ts.tv_nsec = t % 1000000000ull;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+static int load_capture(replay_buf_t *buf, const char *path)
+{
+    rcar_cluster_capture_rec_t rec;
+    FILE *f = fopen(path, "rb");
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    while (fread(&rec, sizeof(rec), 1, f) == 1) {
+        if (buf->count == buf->size) {
+            size_t size = buf->size ? buf->size * 2 : 1024;
+            rcar_cluster_capture_rec_t *p = realloc(buf->rec, size * sizeof(*p));
+
+            if (!p) {
+                fclose(f);
+                return -1;
+            }
+            buf->rec = p;
+            buf->size = size;
+        }
+        buf->rec[buf->count++] = rec;
+    }
+
+    fclose(f);
+    return 0;
+}
+
+static int cmp_rec(const void *a, const void *b)
+{
+    const rcar_cluster_capture_rec_t *ra = a;
+    const rcar_cluster_capture_rec_t *rb = b;
+
+    return ra->ts_ns < rb->ts_ns ? -1 : ra->ts_ns > rb->ts_ns;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t va = *(const uint64_t *)a;
+    uint64_t vb = *(const uint64_t *)b;
+
+    return va < vb ? -1 : va > vb;
+}
+
+/* Time from sending a command to its COMPLETE result in the capture */
+static uint64_t captured_latency(const replay_buf_t *buf, size_t i)
+{
+    const rcar_cluster_capture_rec_t *tx = &buf->rec[i];
+    size_t j;
+
+    for (j = i + 1; j < buf->count; j++) {
+        const rcar_cluster_capture_rec_t *rx = &buf->rec[j];
+
+        if (rx->dir == RCAR_CLUSTER_CAPTURE_RX &&
+            rx->msg.res.Id == tx->msg.cmd.Id &&
+            rx->msg.res.Result != R_TAURUS_RES_ACK)
+            return rx->ts_ns - tx->ts_ns;
+    }
+    return 0;
+}
+
+static void print_stats(const char *name, uint64_t *lat, size_t n)
+{
+    uint64_t sum = 0;
+    size_t i;
+
+    if (!n) {
+        printf("%-9s no samples\n", name);
+        return;
+    }
+
+    qsort(lat, n, sizeof(*lat), cmp_u64);
+    for (i = 0; i < n; i++)
+        sum += lat[i];
+
+    printf("%-9s n=%zu min=%lluus avg=%lluus p50=%lluus p99=%lluus max=%lluus\n",
+           name, n,
+           (unsigned long long)lat[0] / 1000,
+           (unsigned long long)(sum / n) / 1000,
+           (unsigned long long)lat[n / 2] / 1000,
+           (unsigned long long)lat[(n * 99) / 100] / 1000,
+           (unsigned long long)lat[n - 1] / 1000);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *devname = "/dev/rpmsg0";
+    double rate = 1.0;
+    replay_buf_t buf = { 0 };
+    uint64_t *orig_lat, *replay_lat;
+    size_t n_orig = 0, n_replay = 0, i;
+    uint64_t first_ts = 0, start, end;
+    int opt, fd;
+
+    while ((opt = getopt(argc, argv, "d:r:")) != -1) {
+        switch (opt) {
+        case 'd':
+            devname = optarg;
+            break;
+        case 'r':
+            rate = atof(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-d device] [-r rate] capture...\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (optind >= argc || rate < 0) {
+        fprintf(stderr, "usage: %s [-d device] [-r rate] capture...\n", argv[0]);
+        return 1;
+    }
+
+    for (i = optind; i < (size_t)argc; i++)
+        if (load_capture(&buf, argv[i]))
+            return 1;
+
+    qsort(buf.rec, buf.count, sizeof(*buf.rec), cmp_rec);
+
+    orig_lat = calloc(buf.count + 1, sizeof(*orig_lat));
+    replay_lat = calloc(buf.count + 1, sizeof(*replay_lat));
+    if (!orig_lat || !replay_lat)
+        return 1;
+
+    fd = open(devname, O_WRONLY);
+    if (fd < 0) {
+        perror(devname);
+        return 1;
+    }
+
+    start = now_ns();
+    for (i = 0; i < buf.count; i++) {
+        const rcar_cluster_capture_rec_t *rec = &buf.rec[i];
+        taurus_cluster_data_t data;
+        uint64_t t0, lat;
+
+        if (rec->dir != RCAR_CLUSTER_CAPTURE_TX || rec->msg.cmd.Cmd != R_TAURUS_CMD_IOCTL)
+            continue;
+
+        if (!first_ts)
+            first_ts = rec->ts_ns;
+        if (rate > 0)
+            sleep_until_ns(start + (uint64_t)((rec->ts_ns - first_ts) / rate));
+
+        lat = captured_latency(&buf, i);
+        if (lat)
+            orig_lat[n_orig++] = lat;
+
+        data.ioctl_cmd = (int)rec->msg.cmd.Par1;
+        data.value = (int)rec->msg.cmd.Par2;
+
+        t0 = now_ns();
+        if (write(fd, &data, sizeof(data)) != sizeof(data)) {
+            perror("write");
+            continue;
+        }
+        replay_lat[n_replay++] = now_ns() - t0;
+    }
+    end = now_ns();
+
+    close(fd);
+
+    printf("replayed %zu commands in %llums (%.1f cmd/s)\n", n_replay,
+           (unsigned long long)(end - start) / 1000000,
+           n_replay * 1e9 / (double)(end - start ? end - start : 1));
+    print_stats("captured", orig_lat, n_orig);
+    print_stats("replayed", replay_lat, n_replay);
+
+    free(orig_lat);
+    free(replay_lat);
+    free(buf.rec);
+    return 0;
+}